@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef CALIBRATION_HPP
+#define CALIBRATION_HPP
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include "ze_api.h"
+#include "ze_info/device_topology.hpp"
+#include "ze_info/graph_template.hpp"
+
+// cmp_bound_kernel runs close to linearly in its loop counter, the model maps a
+// target duration to the counter: counter = slope * ns + intercept. The
+// defaults are the fit the simulation was first tuned on.
+struct counter_model
+{
+    double slope = 0.0114416;
+    double intercept = -37.4022;
+
+    int counter( double ns ) const { return (int)( ns * slope + intercept ); }
+};
+
+// Fitted models keyed by device ("vendor:device" PCI ids), saved as text with
+// one "key slope intercept" line per device.
+class calibration_store
+{
+public:
+    static calibration_store& get();
+
+    bool load( const std::string& path );
+    bool save( const std::string& path ) const;
+    bool find( const std::string& key, counter_model& model ) const;
+    void set( const std::string& key, const counter_model& model, const std::string& name );
+    // the device's saved model, the defaults when it was never calibrated
+    counter_model model( ze_device_handle_t device ) const;
+
+    static std::string device_key( ze_device_handle_t device );
+
+private:
+    std::map<std::string, counter_model> models;
+    std::map<std::string, std::string> names;
+};
+
+// Startup calibration: every distinct device in the topology gets its saved
+// model, or with --calibrate (or none saved) cmp_bound_kernel is timed over a
+// range of counters, refitted, checked against the graph's targets and saved.
+void calibrate_devices( device_topology& topology, const graph_template& recorded, std::ostream& out );
+
+#endif
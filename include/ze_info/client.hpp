@@ -18,17 +18,51 @@
 #include <mutex>
 #include <numeric>
 #include <algorithm>
+#include <cmath>
 #include  "ze_info/server.hpp"
+#include "ze_info/reactor.hpp"
+#include "ze_info/scenario.hpp"
+#include "tbb/task_arena.h"
+#include "tbb/task_group.h"
+#include "tbb/global_control.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "ze_info/histogram.hpp"
+#include "ze_info/trace.hpp"
 
 using namespace std::chrono;
 extern bool profiling, single_thread;
+extern std::vector<double> percentiles;
+extern std::string histogram_file;
+extern int deadline_us;
+extern int priority_levels;
+extern int max_batch_size;
+extern int input_size;
+extern scenario_type scenario;
+extern int latency_target_us;
+extern int samples_per_query;
+extern int multi_stream_interval_us;
+extern std::string trace_path;
+extern std::string trace_out_path;
+extern bool overlap_copies;
+
+// upper bound on the threads issuing batched queries
+const int max_issue_threads = 1024;
 
 class client
 {
 private:
     int queries, qps, pool_size;
     std::vector<std::chrono::microseconds> dist;
-    std::vector<double> results;
+    // send time of every generated query as an offset from the start of the run
+    std::vector<std::chrono::nanoseconds> arrival;
+    std::vector<int> priorities;
+    // --trace: stays mapped for the run, replay reads the records in place
+    trace_file trace;
+    uint64_t trace_start_ns = 0;
+    tbb::enumerable_thread_specific<latency_histogram> latency;
+    std::atomic<uint64_t> shed_queries{ 0 };
+    std::atomic<uint64_t> missed_deadlines{ 0 };
+    uint64_t delayed_queries = 0;
     std::vector<double> gpu_time;
     std::mutex mtx;
     bool logging;
@@ -38,7 +72,6 @@ private:
     std::vector<gpu_results> gpu_results_vec;
     std::vector<uint64_t> total_gpu_time;
     std::vector <ze_event_handle_t> query_events;
-    std::vector <zenon*> zenonki;
 
     void create_distribution()
     {
@@ -86,6 +119,58 @@ private:
         }
     }
 
+    void create_priorities()
+    {
+        priorities.assign( queries, 0 );
+        if( priority_levels <= 1 )
+            return;
+        std::mt19937 gen( std::random_device{}() );
+        std::uniform_int_distribution<> level( 0, priority_levels - 1 );
+        for( int n = 0; n < queries; ++n )
+            priorities[ n ] = level( gen );
+    }
+
+    bool load_trace()
+    {
+        if( !trace.open( trace_path ) || !trace.size() )
+        {
+            trace.close();
+            std::cout << "Cannot read trace file " << trace_path << ", using poisson distribution." << std::endl;
+            return false;
+        }
+        queries = (int)trace.size();
+        trace_start_ns = trace[ 0 ].timestamp_ns;
+        std::cout << "Replaying " << queries << " queries over " << arrival_at( queries - 1 ).count() / 1e9 << " s from " << trace_path << std::endl;
+        return true;
+    }
+
+    // send time of query n as an offset from the start of the run, a trace
+    // record stamped before the first one is sent at the start
+    std::chrono::nanoseconds arrival_at( int n ) const
+    {
+        if( !trace.size() )
+            return arrival[ n ];
+        uint64_t timestamp = trace[ n ].timestamp_ns;
+        return std::chrono::nanoseconds( timestamp > trace_start_ns ? timestamp - trace_start_ns : 0 );
+    }
+
+    int priority_of( int n ) const
+    {
+        return trace.size() ? (int)trace[ n ].priority : priorities[ n ];
+    }
+
+    void write_trace()
+    {
+        std::vector<trace_record> records( queries );
+        for( int n = 0; n < queries; ++n )
+        {
+            uint32_t model_id = trace.size() ? trace[ n ].model_id : 0;
+            records[ n ] = { (uint64_t)arrival_at( n ).count(), (uint32_t)input_size, model_id, (uint32_t)priority_of( n ), 0 };
+        }
+        if( !trace_file::write( trace_out_path, records ) )
+            std::cout << "Cannot write trace file " << trace_out_path << std::endl;
+    }
+
 public:
     client(int _queries, int _qps, int zenon_pool_size, bool multi_ccs, bool fixed_dist, bool _warm_up, bool log = false) :
         serv(zenon_pool_size, multi_ccs, log)
@@ -93,14 +178,29 @@ public:
         queries = _queries;
         qps = _qps;
         dist.resize(queries);
-        results.resize(queries);
-        zenonki.resize( queries );
         warm_up = _warm_up;
         logging = log;
         pool_size = zenon_pool_size;
         fixed_distribution = fixed_dist;
+        if( trace_path.empty() || !load_trace() )
+        {
+            create_distribution();
+            // the first query goes out at the start, query n after the sum of the previous gaps
+            arrival.resize( queries );
+            create_priorities();
+            std::chrono::nanoseconds offset( 0 );
+            for( int n = 0; n < queries; ++n )
+            {
+                arrival[ n ] = offset;
+                offset += dist[ n ];
+            }
+        }
+        if( !trace_out_path.empty() )
+            write_trace();
         gpu_results_vec.resize(queries);
-        create_distribution();
+        if (max_batch_size > 1 && !single_thread && (long long)serv.get_zenon_count() * max_batch_size > max_issue_threads)
+            std::cout << "Warning: --batch " << max_batch_size << " with --s " << pool_size << " needs " << (long long)serv.get_zenon_count() * max_batch_size
+                      << " issuing threads, capped at " << max_issue_threads << ", batches may not fill" << std::endl;
     }
 
     void run_all()
@@ -110,196 +210,488 @@ public:
 
         // Warmup
         if( warm_up )
-            run_single( 0 );
+        {
+            execute_sample( 0 );
+            latency.clear();
+            shed_queries = 0;
+            missed_deadlines = 0;
+        }
 
         high_resolution_clock::time_point overall_start_time = high_resolution_clock::now();
 
-        if( !single_thread )
+        switch( scenario )
         {
-            std::thread** thread_pool = new std::thread * [ queries ];
-            for( int i = 0; i < queries; i++ )
+        case scenario_type::single_stream:
+            run_single_stream();
+            break;
+        case scenario_type::multi_stream:
+            run_multi_stream( overall_start_time );
+            break;
+        case scenario_type::offline:
+            run_offline( overall_start_time );
+            break;
+        case scenario_type::server:
+            if( !single_thread )
+                run_open_loop( overall_start_time );
+            else
+                run_reactor( overall_start_time );
+            break;
+        }
+
+        high_resolution_clock::time_point overall_end_time = high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> overall = overall_end_time - overall_start_time;
+        std::cout << "Overall duration: " << std::fixed << std::setprecision( 2 ) << overall.count() << std::endl;
+        std::cout << "Throughput: " << queries / ( overall.count() / 1000.0 ) << " queries/s" << std::endl;
+
+        print_results();
+        print_scenario_report( overall.count() );
+        serv.print_pool_stats();
+        serv.print_ccs_stats( overall.count() );
+        zenon::print_submit_stats( std::cout );
+        serv.print_batch_stats();
+        print_fusion_saving();
+        print_overlap_gain();
+        print_zero_copy_gain();
+        serv.delete_zenek();
+    }
+
+    // --fuse: latency of one query at a time through a zenon of the unfused graph
+    // and one of the fused graph on the first slot, alternating between the two
+    // so drift hits both the same, inputs filled like the server fills them.
+    void print_fusion_saving()
+    {
+        const graph_template& fused = graph_template::get();
+        const graph_template& unfused = graph_template::get_unfused();
+        if( &fused == &unfused )
+            return;
+        const int runs = 50;
+        zenon* zenek[ 2 ] = { new zenon( serv.get_zenon_count(), false, false, 0, &unfused ), new zenon( serv.get_zenon_count() + 1, false, false, 0, &fused ) };
+        std::vector<double> us[ 2 ];
+        for( zenon* z : zenek )
+        {
+            z->create_module();
+            z->allocate_buffers();
+            z->create_cmd_list();
+        }
+        for( int r = 0; r <= runs; r++ )
+        {
+            for( int v = 0; v < 2; v++ )
             {
-                thread_pool[ i ] = new std::thread( &client::run_single, this, i );
-                std::this_thread::sleep_for( dist[ i ] );
+                for( std::vector<uint8_t>* in : { zenek[ v ]->get_input1(), zenek[ v ]->get_mem_input1() } )
+                    std::fill( in->begin(), in->end(), r );
+                for( std::vector<uint8_t>* in : { zenek[ v ]->get_input2(), zenek[ v ]->get_mem_input2() } )
+                    std::fill( in->begin(), in->end(), r - 1 );
+                high_resolution_clock::time_point start = high_resolution_clock::now();
+                zenek[ v ]->run( r );
+                if( single_thread )
+                {
+                    zenek[ v ]->wait_finished( UINT64_MAX );
+                    zenek[ v ]->get_result( r );
+                }
+                // the first run of each warms up
+                if( r > 0 )
+                    us[ v ].push_back( std::chrono::duration<double, std::micro>( high_resolution_clock::now() - start ).count() );
             }
-            for( int i = 0; i < queries; i++ )
+        }
+        for( zenon* z : zenek )
+            delete z;
+        double median[ 2 ];
+        for( int v = 0; v < 2; v++ )
+        {
+            std::nth_element( us[ v ].begin(), us[ v ].begin() + runs / 2, us[ v ].end() );
+            median[ v ] = us[ v ][ runs / 2 ];
+        }
+        std::cout << "Fusion: launches per query: " << unfused.get_launches().size() << " -> " << fused.get_launches().size()
+                  << " \t median latency of " << runs << " queries alone, unfused: " << median[ 0 ] << " us \t fused: " << median[ 1 ] << " us"
+                  << " \t saved: " << median[ 0 ] - median[ 1 ] << " us (" << ( median[ 0 ] > 0 ? ( median[ 0 ] - median[ 1 ] ) * 100.0 / median[ 0 ] : 0.0 ) << "%)\n";
+    }
+
+    // --overlap: queries back to back through a zenon of the first slot, first
+    // with its own buffer set only, then with a twin taking every other query,
+    // so one uploads while the other computes. Inputs filled like the server
+    // fills them.
+    void print_overlap_gain()
+    {
+        if( !overlap_copies || disable_blitter )
+            return;
+        const int runs = 200;
+        zenon owner( serv.get_zenon_count(), false, false, 0 );
+        zenon twin( serv.get_zenon_count() + 1, false, false, 0 );
+        twin.share_intermediates( owner );
+        for( zenon* z : { &owner, &twin } )
+        {
+            z->create_module();
+            z->allocate_buffers();
+            z->create_cmd_list();
+        }
+        auto run_queries = []( zenon* z, int first, int step, int count )
+        {
+            for( int r = first; r < count; r += step )
             {
-                thread_pool[ i ]->join();
-                delete thread_pool[ i ];
+                for( std::vector<uint8_t>* in : { z->get_input1(), z->get_mem_input1() } )
+                    std::fill( in->begin(), in->end(), r );
+                for( std::vector<uint8_t>* in : { z->get_input2(), z->get_mem_input2() } )
+                    std::fill( in->begin(), in->end(), r - 1 );
+                z->run( r );
+                if( single_thread )
+                {
+                    z->wait_finished( UINT64_MAX );
+                    z->get_result( r );
+                }
             }
-        }
-        else
+        };
+        // warms up both
+        run_queries( &owner, 0, 1, 2 );
+        run_queries( &twin, 0, 1, 2 );
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+        run_queries( &owner, 0, 1, runs );
+        double single_ms = std::chrono::duration<double, std::milli>( high_resolution_clock::now() - start ).count();
+        start = high_resolution_clock::now();
+        std::thread other( run_queries, &twin, 1, 2, runs );
+        run_queries( &owner, 0, 2, runs );
+        other.join();
+        double double_ms = std::chrono::duration<double, std::milli>( high_resolution_clock::now() - start ).count();
+        double single_qps = runs / ( single_ms / 1000.0 ), double_qps = runs / ( double_ms / 1000.0 );
+        std::cout << "Overlap: " << runs << " queries back to back on one zenon, one buffer set: " << single_qps
+                  << " queries/s \t two buffer sets: " << double_qps << " queries/s \t gain: "
+                  << ( single_qps > 0 ? ( double_qps - single_qps ) * 100.0 / single_qps : 0.0 ) << "%\n";
+    }
+
+    // --zero_copy: latency of one query at a time through a zenon of a payload's
+    // slot, alternating between its own vectors and the payload, both written
+    // with the same contents before each run.
+    void print_zero_copy_gain()
+    {
+        host_payload* payload = serv.acquire_payload();
+        if( !payload )
+            return;
+        const int runs = 50;
+        zenon zenek( serv.get_zenon_count(), false, false, payload->slot );
+        zenek.create_module();
+        zenek.allocate_buffers();
+        zenek.create_cmd_list();
+        std::vector<double> us[ 2 ];
+        for( int r = 0; r <= runs; r++ )
         {
-            int q = 0;
-            std::chrono::microseconds cumulative_dist = std::chrono::microseconds(0);
-            std::chrono::duration<double, std::micro> differ;
-            high_resolution_clock::time_point dist_start_time = high_resolution_clock::now();
-            high_resolution_clock::time_point current = high_resolution_clock::now();
-            high_resolution_clock::time_point start = high_resolution_clock::now();
-            for( ; q < pool_size; q++ )
+            for( int v = 0; v < 2; v++ )
             {
-                zenonki[ q ] = serv.query_sample( q );
-                
-                if( q + 1 < queries )
+                high_resolution_clock::time_point start = high_resolution_clock::now();
+                if( v )
                 {
-                    cumulative_dist += dist[ q ];
-                    current = high_resolution_clock::now();
-                    differ = current - dist_start_time;
-                    std::chrono::duration<double, std::micro> diff = cumulative_dist - differ;
-                    std::this_thread::sleep_for( diff );
+                    fill_payload( *payload, r );
+                    zenek.set_payload( payload );
                 }
-               
+                else
+                {
+                    for( std::vector<uint8_t>* in : { zenek.get_input1(), zenek.get_mem_input1() } )
+                        std::fill( in->begin(), in->end(), r );
+                    for( std::vector<uint8_t>* in : { zenek.get_input2(), zenek.get_mem_input2() } )
+                        std::fill( in->begin(), in->end(), r - 1 );
+                }
+                zenek.run( r );
+                if( single_thread )
+                {
+                    zenek.wait_finished( UINT64_MAX );
+                    zenek.get_result( r );
+                }
+                zenek.set_payload( nullptr );
+                // the first run of each warms up
+                if( r > 0 )
+                    us[ v ].push_back( std::chrono::duration<double, std::micro>( high_resolution_clock::now() - start ).count() );
             }
+        }
+        serv.release_payload( payload );
+        double median[ 2 ];
+        for( int v = 0; v < 2; v++ )
+        {
+            std::nth_element( us[ v ].begin(), us[ v ].begin() + runs / 2, us[ v ].end() );
+            median[ v ] = us[ v ][ runs / 2 ];
+        }
+        std::cout << "Zero copy: median latency of " << runs << " queries alone, inputs filled and uploaded, copied: " << median[ 0 ]
+                  << " us \t from payload: " << median[ 1 ] << " us \t saved: " << median[ 0 ] - median[ 1 ] << " us\n";
+    }
+
+    // Open-loop issue: every query has an intended send time derived from the
+    // distribution and its latency is measured from that point, so queueing
+    // behind busy workers is accounted for instead of hidden.
+    void run_open_loop( high_resolution_clock::time_point start_time )
+    {
+        tbb::global_control parallelism( tbb::global_control::max_allowed_parallelism, issue_threads() + 1 );
+        tbb::task_arena workers( issue_threads(), 0 );
+        tbb::task_group group;
+        for( int i = 0; i < queries; i++ )
+        {
+            // absolute send times, oversleeping one query does not shift the rest
+            high_resolution_clock::time_point intended_time = start_time + arrival_at( i );
+            std::this_thread::sleep_until( intended_time );
+            workers.execute( [ &, i, intended_time ] { group.run( [ this, i, intended_time ] { run_single( i, intended_time ); } ); } );
+        }
+        workers.execute( [ & ] { group.wait(); } );
+    }
+
+    void run_reactor( high_resolution_clock::time_point start_time )
+    {
+        completion_reactor reactor;
+        high_resolution_clock::time_point intended_time = start_time + ( queries ? arrival_at( 0 ) : nanoseconds( 0 ) );
+        int next = 0, finish_count = 0;
+        auto on_complete = [ & ]( const inflight_query& q )
+        {
+            high_resolution_clock::time_point end_time = high_resolution_clock::now();
+            std::chrono::duration<double, std::micro> ms = end_time - q.intended_time;
+            if( logging )
+                std::cout << "thread:" << q.qid << " duration: " << ms.count() << std::endl;
 
-            int cntr = 0, finish_count = 0;
-            while( 1 )
+            record_latency( ms.count() );
+            if( profiling )
+                q.zenek->set_timestamps();
+            gpu_results_vec[ q.qid ] = serv.get_result( q.qid, q.zenek );
+            if( q.payload )
+                serv.release_payload( q.payload );
+        };
+        while( finish_count < queries )
+        {
+            // every free pool slot takes the queries that are already due
+            while( next < queries && reactor.size() < (size_t)serv.get_zenon_count() && high_resolution_clock::now() >= intended_time )
             {
-                if( serv.is_finished( cntr, zenonki[ cntr ] ) )
+                if( deadline_us > 0 && !serv.can_meet_deadline( intended_time + microseconds( deadline_us ) ) )
                 {
-                    high_resolution_clock::time_point end_time = high_resolution_clock::now();
-                    std::chrono::duration<double, std::micro> ms = end_time - start;
-                    if (logging)
-                        std::cout << "thread:" << q << " duration: " << ms.count() << std::endl;
-
-                    results[cntr] = ms.count();
-                    zenonki[cntr]->set_timestamps();
-                    
-                    serv.get_result( cntr, zenonki[ cntr ] );
+                    shed_queries++;
                     finish_count++;
-                    if( q < queries )
-                    {
-                        zenonki[ cntr ] = serv.query_sample( q++ );
-                        if( q < queries )
-                        {
-                            cumulative_dist += dist[ q ];
-                            current = high_resolution_clock::now();
-                            differ = current - dist_start_time;
-                            std::chrono::duration<double, std::micro> diff = cumulative_dist - differ;
-                            std::this_thread::sleep_for( diff );
-                        }
-                    }
                 }
-                if( finish_count == queries )
-                    break;
-                cntr++;
-                cntr = cntr % pool_size;
+                else if( host_payload* payload = serv.acquire_payload() )
+                {
+                    fill_payload( *payload, next );
+                    reactor.add( next, serv.query_sample( *payload, next ), intended_time, payload );
+                }
+                else
+                    reactor.add( next, serv.query_sample( next ), intended_time );
+                next++;
+                if( next < queries )
+                    intended_time = start_time + arrival_at( next );
+            }
+            if( reactor.empty() )
+            {
+                std::this_thread::sleep_until( intended_time );
+                continue;
             }
+            bool can_issue = next < queries && reactor.size() < (size_t)serv.get_zenon_count();
+            finish_count += reactor.wait( on_complete, can_issue ? intended_time : high_resolution_clock::time_point::max() );
         }
+        if( logging )
+            std::cout << "reactor sweeps: " << reactor.get_sweeps() << " blocks: " << reactor.get_blocks() << std::endl;
+    }
 
-        high_resolution_clock::time_point overall_end_time = high_resolution_clock::now();
-        std::chrono::duration<double, std::milli> overall = overall_end_time - overall_start_time;
-        std::cout << "Overall duration: " << std::fixed << std::setprecision( 2 ) << overall.count() << std::endl;
+    // Closed loop, one query in flight at a time.
+    void run_single_stream()
+    {
+        for( int i = 0; i < queries; i++ )
+        {
+            high_resolution_clock::time_point start_time = high_resolution_clock::now();
+            execute_sample( i );
+            std::chrono::duration<double, std::micro> ms = high_resolution_clock::now() - start_time;
+            record_latency( ms.count() );
+        }
+    }
 
-        print_results();
-        serv.delete_zenek();
+    // A query of samples_per_query samples is due every multi_stream_interval_us.
+    // A query that is still running when the next one is due delays it; the
+    // latency of the delayed query is still measured from its due time.
+    void run_multi_stream( high_resolution_clock::time_point start_time )
+    {
+        tbb::global_control parallelism( tbb::global_control::max_allowed_parallelism, issue_threads() + 1 );
+        tbb::task_arena workers( issue_threads(), 0 );
+        int query_count = ( queries + samples_per_query - 1 ) / samples_per_query;
+        for( int k = 0; k < query_count; k++ )
+        {
+            high_resolution_clock::time_point due_time = start_time + microseconds( (long long)k * multi_stream_interval_us );
+            if( high_resolution_clock::now() > due_time )
+                delayed_queries++;
+            std::this_thread::sleep_until( due_time );
+            int first = k * samples_per_query;
+            int last = std::min( queries, first + samples_per_query );
+            workers.execute( [ & ]
+            {
+                tbb::task_group group;
+                for( int i = first; i < last; i++ )
+                    group.run( [ this, i ] { execute_sample( i ); } );
+                group.wait();
+            } );
+            std::chrono::duration<double, std::micro> ms = high_resolution_clock::now() - due_time;
+            record_latency( ms.count() );
+        }
     }
-    
-    void run_single(int qid)
+
+    // Every query is available at the start; only throughput matters.
+    void run_offline( high_resolution_clock::time_point start_time )
+    {
+        tbb::global_control parallelism( tbb::global_control::max_allowed_parallelism, issue_threads() + 1 );
+        tbb::task_arena workers( issue_threads(), 0 );
+        workers.execute( [ & ]
+        {
+            tbb::task_group group;
+            for( int i = 0; i < queries; i++ )
+                group.run( [ this, i, start_time ] { run_single( i, start_time ); } );
+            group.wait();
+        } );
+    }
+
+    // A batched query blocks its thread until the batch is done, a zenon needs
+    // max_batch_size of them waiting to run full batches, every zenon at once.
+    int issue_threads() const
+    {
+        if( max_batch_size <= 1 || single_thread )
+            return serv.get_zenon_count();
+        return (int)std::min<long long>( (long long)serv.get_zenon_count() * max_batch_size, max_issue_threads );
+    }
+
+    // --zero_copy: the same inputs the server writes into a zenon's own vectors
+    static void fill_payload( host_payload& payload, int qid )
+    {
+        std::fill( payload.input1, payload.input1 + payload.input_bytes, (uint8_t)qid );
+        std::fill( payload.input2, payload.input2 + payload.input_bytes, (uint8_t)( qid - 1 ) );
+        std::fill( payload.mem_input1, payload.mem_input1 + payload.mem_bytes, (uint8_t)qid );
+        std::fill( payload.mem_input2, payload.mem_input2 + payload.mem_bytes, (uint8_t)( qid - 1 ) );
+    }
+
+    // Runs one sample to completion in either threading mode.
+    void execute_sample( int qid )
+    {
+        host_payload* payload = serv.acquire_payload();
+        if( payload )
+            fill_payload( *payload, qid );
+        if( single_thread )
+        {
+            zenon* zenek = payload ? serv.query_sample( *payload, qid ) : serv.query_sample( qid );
+            zenek->wait_finished( UINT64_MAX );
+            if( profiling )
+                zenek->set_timestamps();
+            gpu_results_vec[ qid ] = serv.get_result( qid, zenek );
+        }
+        else if( payload )
+            gpu_results_vec[ qid ] = serv.query_sample_multiple_threads( *payload, qid );
+        else
+            gpu_results_vec[ qid ] = serv.query_sample_multiple_threads( qid );
+        if( payload )
+            serv.release_payload( payload );
+    }
+
+    void run_single(int qid, high_resolution_clock::time_point intended_time)
     {
-        high_resolution_clock::time_point start_time = high_resolution_clock::now();
         try
         {
-            gpu_results_vec[qid] = serv.query_sample_multiple_threads(qid);
+            if( deadline_us > 0 && max_batch_size <= 1 )
+            {
+                if( !serv.query_sample_deadline( qid, intended_time + microseconds( deadline_us ), priority_of( qid ), gpu_results_vec[ qid ] ) )
+                {
+                    shed_queries++;
+                    return;
+                }
+            }
+            else
+                execute_sample( qid );
         }
         catch (std::exception ex)
         {    
             std::cout << ex.what();
         }
         high_resolution_clock::time_point end_time = high_resolution_clock::now();
-        std::chrono::duration<double, std::micro> ms = end_time - start_time;
+        std::chrono::duration<double, std::micro> ms = end_time - intended_time;
         if (logging)
             std::cout << "thread:" << qid << " duration: " << ms.count() << std::endl;
 
-        results[qid] = ms.count();
+        record_latency( ms.count() );
     }
     
+    void record_latency( double us )
+    {
+        latency.local().record( us );
+        if( deadline_us > 0 && us > deadline_us )
+            missed_deadlines++;
+    }
+
     void print_dist()
     {
         for (int n = 0; n < queries; ++n)
-            std::cout << dist[n].count() << ";";
+            std::cout << std::chrono::duration_cast<std::chrono::microseconds>(arrival_at(n) - (n ? arrival_at(n - 1) : nanoseconds(0))).count() << ";";
         std::cout << std::endl;
     }
 
     void print_profiling()
     {
         int kernels_count;
-        if (!single_thread) {
-            kernels_count = gpu_results_vec.at(0).kernel_time.size();
-            std::vector<uint64_t> total_exec_time;
+        // shed queries leave empty results behind
+        gpu_results_vec.erase( std::remove_if( gpu_results_vec.begin(), gpu_results_vec.end(), []( const gpu_results& r ) { return r.kernel_time.empty(); } ), gpu_results_vec.end() );
+        if( gpu_results_vec.empty() )
+            return;
+        kernels_count = gpu_results_vec.at(0).kernel_time.size();
+        const network_graph* graph = get_network_graph();
+        const std::vector<launch_record>& launches = graph_template::get().get_launches();
+        std::vector<uint64_t> total_exec_time;
+        double target_error_sum = 0.0;
+        int targets = 0;
 
-            for (int j = 0; j < kernels_count; j++)
+        for (int j = 0; j < kernels_count; j++)
+        {
+            std::vector<uint64_t> kernel_exec_times;
+            for (int i = 0; i < gpu_results_vec.size(); i++)
             {
-                std::vector<uint64_t> kernel_exec_times;
-                for (int i = 0; i < gpu_results_vec.size(); i++)
-                {
-                    kernel_exec_times.push_back(gpu_results_vec.at(i).kernel_time.at(j));
-                    if (j == 0) {
-                        total_exec_time.push_back(gpu_results_vec.at(i).execuction_time);
-                    }
+                kernel_exec_times.push_back(gpu_results_vec.at(i).kernel_time.at(j));
+                if (j == 0) {
+                    total_exec_time.push_back(gpu_results_vec.at(i).execuction_time);
                 }
-                uint64_t kernel_max = *std::max_element(kernel_exec_times.begin(), kernel_exec_times.end());
-                uint64_t kernel_min = *std::min_element(kernel_exec_times.begin(), kernel_exec_times.end());
-                double kernel_avg_v = avg_u(kernel_exec_times);
-                std::cout << "kernel " << j << "\t" << gpu_results_vec.at(0).kernel_name.at(j) << ":\tMin: " << kernel_min << " ns\t" << "Max: " << kernel_max << " ns\t" << "Avg: " << kernel_avg_v << " ns \n";
-            }
-            uint64_t kernels_starts = gpu_results_vec.at(0).kernels_start_time;
-            uint64_t kernels_ends = 0;
-            for (int i = 0; i < gpu_results_vec.size(); i++) {
-                if (kernels_ends < gpu_results_vec.at(i).kernels_end_time)
-                    kernels_ends = gpu_results_vec.at(i).kernels_end_time;
             }
-            uint64_t gpu_max = *std::max_element(total_exec_time.begin(), total_exec_time.end()) / 1000;
-            uint64_t gpu_min = *std::min_element(total_exec_time.begin(), total_exec_time.end()) / 1000;
-            double gpu_avg_v = avg_u(total_exec_time) / 1000;
-
-            total_gpu_time = get_total_gpu_time_vec(gpu_results_vec);
-            uint64_t total_gpu_max = *std::max_element(total_gpu_time.begin(), total_gpu_time.end()) / 1000; //1st kernel start -> last kernel end max
-            uint64_t total_gpu_min = *std::min_element(total_gpu_time.begin(), total_gpu_time.end()) / 1000; //1st kernel start -> last kernel end min
-            double total_gpu_avg = avg_u(total_gpu_time) / 1000; //1st kernel start -> last kernel end avg
-            std::cout << "\nTime from 1st kernel start to last kernel end\t" << (kernels_ends - kernels_starts) / 1000 << " us \n\n";
-            std::cout << "Total kernels time: Min: " << gpu_min << " us\t\t Max: " << gpu_max << " us \t\t Avg: " << gpu_avg_v << " us \n";
-            std::cout << "Total GPU time:     Min: " << total_gpu_min << " us\t\t Max: " << total_gpu_max << " us \t\t Avg: " << total_gpu_avg << " us \n";
-
-
-        }
-        else {
-            kernels_count = zenonki[0]->get_result(0).kernel_time.size();
-            std::vector<uint64_t> total_exec_time;
-
-            for (int j = 0; j < kernels_count; j++)
+            uint64_t kernel_max = *std::max_element(kernel_exec_times.begin(), kernel_exec_times.end());
+            uint64_t kernel_min = *std::min_element(kernel_exec_times.begin(), kernel_exec_times.end());
+            double kernel_avg_v = avg_u(kernel_exec_times);
+            std::cout << "kernel " << j << "\t" << gpu_results_vec.at(0).kernel_name.at(j) << ":\tMin: " << kernel_min << " ns\t" << "Max: " << kernel_max << " ns\t" << "Avg: " << kernel_avg_v << " ns";
+            // how well the device's counter model hits the node's duration, a fused
+            // launch should take as long as the nodes it replaced were meant to
+            const graph_node& node = graph->get_nodes().at(j);
+            const double target = launches.at(j).target_ns;
+            if (node.kernel == graph_kernel::cmp_bound && target > 0)
             {
-                std::vector<uint64_t> kernel_exec_times;
-                for (int i = 0; i < zenonki.size(); i++)
-                {
-                    kernel_exec_times.push_back(zenonki[i]->get_result(j).kernel_time.at(j));
-                    if (j == 0) {
-                        total_exec_time.push_back(zenonki[i]->get_result(j).execuction_time);
-                    }
-                }
-                uint64_t kernel_max = *std::max_element(kernel_exec_times.begin(), kernel_exec_times.end());
-                uint64_t kernel_min = *std::min_element(kernel_exec_times.begin(), kernel_exec_times.end());
-                double kernel_avg_v = avg_u(kernel_exec_times);
-                std::cout << "kernel " << j << "\t" << zenonki[0]->get_result(j).kernel_name.at(j) << ":\tMin: " << kernel_min << " ns\t" << "Max: " << kernel_max << " ns\t" << "Avg: " << kernel_avg_v << " ns \n";
-            }
-            uint64_t kernels_starts = zenonki[0]->get_result(0).kernels_start_time;
-            uint64_t kernels_ends = 0;
-            for (int i = 0; i < zenonki.size(); i++) {
-                if (kernels_ends < zenonki[i]->get_result(i).kernels_end_time)
-                    kernels_ends = zenonki[i]->get_result(i).kernels_end_time;
+                double error = (kernel_avg_v - target) * 100.0 / target;
+                std::cout << "\t";
+                if (node.fused > 1)
+                    std::cout << "fused " << node.fused << ", ";
+                std::cout << "target: " << target << " ns (" << std::showpos << error << std::noshowpos << "%)";
+                target_error_sum += std::fabs(error);
+                targets++;
             }
-            uint64_t gpu_max = *std::max_element(total_exec_time.begin(), total_exec_time.end()) / 1000;
-            uint64_t gpu_min = *std::min_element(total_exec_time.begin(), total_exec_time.end()) / 1000;
-            double gpu_avg_v = avg_u(total_exec_time) / 1000;
-
-            total_gpu_time = get_total_gpu_time_vec_from_zenonki(zenonki);
-            uint64_t total_gpu_max = *std::max_element(total_gpu_time.begin(), total_gpu_time.end()) / 1000; //1st kernel start -> last kernel end max
-            uint64_t total_gpu_min = *std::min_element(total_gpu_time.begin(), total_gpu_time.end()) / 1000; //1st kernel start -> last kernel end min
-            double total_gpu_avg = avg_u(total_gpu_time) / 1000; //1st kernel start -> last kernel end avg
-            std::cout << "\nTime from 1st kernel start to last kernel end\t" << (kernels_ends - kernels_starts) / 1000 << " us \n\n";
-            std::cout << "Total kernels time: Min: " << gpu_min << " us\t\t Max: " << gpu_max << " us \t\t Avg: " << gpu_avg_v << " us \n";
-            std::cout << "Total GPU time:     Min: " << total_gpu_min << " us\t\t Max: " << total_gpu_max << " us \t\t Avg: " << total_gpu_avg << " us \n";
+            std::cout << "\n";
+        }
+        if (targets)
+            std::cout << "cmp_bound targets: " << targets << " \t mean error: " << target_error_sum / targets << "%\n";
+        uint64_t kernels_starts = gpu_results_vec.at(0).kernels_start_time;
+        uint64_t kernels_ends = 0;
+        for (int i = 0; i < gpu_results_vec.size(); i++) {
+            if (kernels_ends < gpu_results_vec.at(i).kernels_end_time)
+                kernels_ends = gpu_results_vec.at(i).kernels_end_time;
+        }
+        uint64_t gpu_max = *std::max_element(total_exec_time.begin(), total_exec_time.end()) / 1000;
+        uint64_t gpu_min = *std::min_element(total_exec_time.begin(), total_exec_time.end()) / 1000;
+        double gpu_avg_v = avg_u(total_exec_time) / 1000;
 
+        total_gpu_time = get_total_gpu_time_vec(gpu_results_vec);
+        uint64_t total_gpu_max = *std::max_element(total_gpu_time.begin(), total_gpu_time.end()) / 1000; //1st kernel start -> last kernel end max
+        uint64_t total_gpu_min = *std::min_element(total_gpu_time.begin(), total_gpu_time.end()) / 1000; //1st kernel start -> last kernel end min
+        double total_gpu_avg = avg_u(total_gpu_time) / 1000; //1st kernel start -> last kernel end avg
+        std::cout << "\nTime from 1st kernel start to last kernel end\t" << (kernels_ends - kernels_starts) / 1000 << " us \n\n";
+        std::cout << "Total kernels time: Min: " << gpu_min << " us\t\t Max: " << gpu_max << " us \t\t Avg: " << gpu_avg_v << " us \n";
+        std::cout << "Total GPU time:     Min: " << total_gpu_min << " us\t\t Max: " << total_gpu_max << " us \t\t Avg: " << total_gpu_avg << " us \n";
+        // below 1.0 only when branches overlapped (--branch_parallel)
+        if( gpu_avg_v > 0 )
+            std::cout << "Makespan / serial kernels time: " << total_gpu_avg / gpu_avg_v << "\n";
+        // idle time between dependent launches, --fuse measures what removing them saves
+        if( kernels_count > 1 )
+        {
+            double gap = std::max( 0.0, ( total_gpu_avg - gpu_avg_v ) / ( kernels_count - 1 ) );
+            std::cout << "Avg gap between launches: " << gap << " us\n";
         }
+        device_topology& topology = device_topology::get();
+        if( !topology.is_fake() )
+            compare_kernel_variants( topology.slot( 0 ), graph_template::get(), std::cout );
+
     }
 
     double avg(std::vector<double> const& v)
@@ -320,24 +712,75 @@ public:
         }
         return total_gpu_time_vec;
     }
-    std::vector<uint64_t> get_total_gpu_time_vec_from_zenonki(std::vector<zenon*> v)
+
+    latency_histogram merged_latency()
     {
-        std::vector<uint64_t> total_gpu_time_vec;
-        for (int i = 0; i < v.size(); i++) {
-            total_gpu_time_vec.push_back(v.at(i)->get_result(i).gpu_time);
-        }
-        return total_gpu_time_vec;
+        latency_histogram merged;
+        latency.combine_each( [ &merged ]( const latency_histogram& h ) { merged.merge( h ); } );
+        return merged;
     }
 
+    void print_scenario_report( double overall_ms )
+    {
+        latency_histogram merged = merged_latency();
+        std::cout << "Scenario: " << to_string( scenario ) << "\n";
+        switch( scenario )
+        {
+        case scenario_type::single_stream:
+        {
+            double p90 = merged.percentile( 90.0 );
+            std::cout << "  90th percentile latency: " << p90 << " us";
+            if( latency_target_us > 0 )
+                std::cout << " \t target: " << latency_target_us << " us \t Result: " << ( p90 <= latency_target_us ? "PASS" : "FAIL" );
+            std::cout << "\n";
+            break;
+        }
+        case scenario_type::multi_stream:
+        {
+            double p99 = merged.percentile( 99.0 );
+            std::cout << "  samples per query: " << samples_per_query << " \t interval: " << multi_stream_interval_us << " us \t delayed queries: " << delayed_queries << "\n";
+            std::cout << "  99th percentile query latency: " << p99 << " us \t Result: " << ( p99 <= multi_stream_interval_us ? "PASS" : "FAIL" ) << "\n";
+            break;
+        }
+        case scenario_type::server:
+        {
+            double p99 = merged.percentile( 99.0 );
+            std::cout << "  scheduled: " << qps << " queries/s \t achieved: " << merged.count() / ( overall_ms / 1000.0 ) << " queries/s\n";
+            std::cout << "  99th percentile latency: " << p99 << " us";
+            if( latency_target_us > 0 )
+                std::cout << " \t target: " << latency_target_us << " us \t Result: " << ( p99 <= latency_target_us ? "PASS" : "FAIL" );
+            std::cout << "\n";
+            break;
+        }
+        case scenario_type::offline:
+            std::cout << "  samples per second: " << merged.count() / ( overall_ms / 1000.0 ) << " \t Result: " << ( merged.count() == (uint64_t)queries ? "VALID" : "INVALID" ) << "\n";
+            break;
+        }
+    }
 
     void print_results()
     {
-        double max = *std::max_element(results.begin(), results.end());
-        double min = *std::min_element(results.begin(), results.end());
-        double avg_v = avg(results);
+        latency_histogram merged = merged_latency();
         if (profiling)
             print_profiling();
-        std::cout << "CPU:                Min: " << min << " us \t Max: " << max << " us \t Avg: " << avg_v << " us \n";
+        std::cout << "CPU:                Min: " << merged.min() << " us \t Max: " << merged.max() << " us \t Avg: " << merged.avg() << " us \n";
+        std::cout << "CPU percentiles:   ";
+        for( double p : percentiles )
+            std::cout << " p" << p << ": " << merged.percentile( p ) << " us \t";
+        std::cout << "\n";
+        if( deadline_us > 0 )
+        {
+            std::cout << "Deadline " << deadline_us << " us:  Shed: " << shed_queries.load() << " (" << 100.0 * shed_queries.load() / queries << "%)"
+                << " \t Completed late: " << missed_deadlines.load() << " (" << 100.0 * missed_deadlines.load() / queries << "%)\n";
+            serv.print_shed_stats();
+        }
+        if( !histogram_file.empty() )
+        {
+            if( merged.export_buckets( histogram_file ) )
+                std::cout << "Latency histogram saved to " << histogram_file << std::endl;
+            else
+                std::cout << "Cannot write latency histogram to " << histogram_file << std::endl;
+        }
     }
 };
 
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef CPU_GRAPH_HPP
+#define CPU_GRAPH_HPP
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "tbb/flow_graph.h"
+#include "ze_info/graph_template.hpp"
+#include "ze_info/cpu_kernels.hpp"
+
+// --backend cpu: the graph of one zenon as a TBB flow graph. Every node is a
+// continue_node that runs when all its dependencies have, so independent
+// branches run in parallel, and each launch spreads its work items with
+// parallel_for.
+class cpu_graph
+{
+public:
+    // tensors holds the host buffer of every graph tensor and its size
+    cpu_graph( const graph_template& recorded, const std::vector<void*>& tensors, const std::vector<size_t>& tensor_bytes );
+    ~cpu_graph();
+
+    // starts a run and returns, wait() or finish() for the end
+    void start();
+    bool is_finished() const { return done.load(); }
+    bool wait( uint64_t timeout_ns );
+    void finish();
+
+    // per node start and end of the last run, ns
+    const std::vector<uint64_t>& get_start_ns() const { return start_ns; }
+    const std::vector<uint64_t>& get_end_ns() const { return end_ns; }
+
+private:
+    typedef tbb::flow::continue_node<tbb::flow::continue_msg> node_type;
+
+    tbb::flow::graph flow;
+    tbb::flow::broadcast_node<tbb::flow::continue_msg> source;
+    std::vector<std::unique_ptr<node_type>> nodes;
+    std::unique_ptr<node_type> done_node;
+    std::vector<cpu_launch> launches;
+    std::vector<uint64_t> start_ns, end_ns;
+    std::atomic<bool> done{ true };
+
+    void run_node( size_t n );
+};
+
+#endif
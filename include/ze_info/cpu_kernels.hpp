@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef CPU_KERNELS_HPP
+#define CPU_KERNELS_HPP
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+#include "ze_info/graph.hpp"
+
+// Arguments of one launch, as module.cl gets them. Buffers are char in OpenCL,
+// so signed here too.
+struct cpu_launch
+{
+    graph_kernel kernel;
+    const int8_t* input1 = nullptr;
+    const int8_t* input2 = nullptr;
+    int8_t* output = nullptr;
+    size_t output_bytes = 0;
+    int counter = 0;
+    int threads = 1;
+    int input_size = 0;
+};
+
+// Instruction set the host kernels are run with, in increasing order. scalar is
+// the reference every other level has to match byte for byte.
+enum class cpu_isa
+{
+    scalar,
+    sse4,
+    avx2,
+    avx512
+};
+
+const char* to_string( cpu_isa isa );
+// best level this CPU (and OS) supports, detected once
+cpu_isa detect_cpu_isa();
+
+// Host versions of the kernels in kernels/module.cl. Work items are output
+// bytes for the elementwise kernels (add, cmp_bound, copy, set_n) and
+// sub-groups for mem_bound, whose prefix sums run along a block. Runs work
+// items [first_id, last_id) with the detected ISA, or the given one.
+void run_cpu_kernel( const cpu_launch& launch, int first_id, int last_id );
+void run_cpu_kernel( const cpu_launch& launch, int first_id, int last_id, cpu_isa isa );
+
+int cpu_work_items( const cpu_launch& launch );
+// smallest range worth handing to one task
+int cpu_work_grain( const cpu_launch& launch );
+
+// --cpu_kernel_bench: times every kernel at every ISA level the CPU has and
+// checks the outputs against scalar. Returns false on a mismatch.
+bool bench_cpu_kernels( std::ostream& out, int threads, int input_size, int mem_kb );
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef DEVICE_TOPOLOGY_HPP
+#define DEVICE_TOPOLOGY_HPP
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <memory>
+#include <chrono>
+#include "ze_api.h"
+
+// Compute engine (CCS) queue shared by every zenon of a slot. Submissions to one
+// Level Zero queue are not thread safe, so they go through mtx.
+struct ccs_queue
+{
+    uint32_t index = 0;
+    ze_command_queue_handle_t queue = nullptr;
+    std::mutex mtx;
+    std::atomic<uint32_t> inflight{ 0 };
+    std::atomic<uint64_t> submitted{ 0 };
+    // time with at least one query in flight
+    uint64_t busy_ns = 0;
+    std::chrono::high_resolution_clock::time_point busy_since;
+};
+
+// One place a zenon can live on: a sub-device (tile), or a whole device when it
+// has no sub-devices. Slots of the same device share its context.
+struct device_slot
+{
+    int device_index;
+    int sub_device_index; // -1 for a device without sub-devices
+    ze_device_handle_t device = nullptr;
+    ze_context_handle_t context = nullptr;
+    uint32_t compute_ordinal = 0;
+    uint32_t copy_ordinal = 0;
+    uint32_t compute_queue_count = 1;
+    std::atomic<uint32_t> zenon_count{ 0 };
+    std::vector<std::unique_ptr<ccs_queue>> ccs;
+
+    device_slot( int _device_index, int _sub_device_index ) :
+        device_index( _device_index ),
+        sub_device_index( _sub_device_index )
+    {
+    }
+
+    std::string name() const;
+
+    // Picks the engine with the fewest queries in flight and counts the new one.
+    // Only engine 0 is used with multi_ccs off.
+    ccs_queue& acquire_ccs( bool multi_ccs );
+    // count distinct engines for the lanes of one query, the least loaded first
+    // and its neighbours after it. Submitting the lanes of a query has to hold
+    // submit_mtx, or two queries waiting across each other's queues can deadlock.
+    std::vector<ccs_queue*> acquire_ccs_group( size_t count, bool multi_ccs );
+    void release_ccs( ccs_queue& engine );
+    std::mutex submit_mtx;
+    void print_ccs_stats( std::ostream& out, double wall_ms ) const;
+
+private:
+    void mark_busy( ccs_queue& engine );
+};
+
+// Every GPU device and sub-device of the first driver, with a context per device.
+// enumerate() asks Level Zero; enumerate_fake() builds the same layout without
+// touching the driver. --backend cpu runs on one fake slot, --fake_devices on as
+// many as asked for, so placement and routing run for real on a host without
+// the hardware.
+class device_topology
+{
+public:
+    static device_topology& get();
+
+    void enumerate( bool log = false );
+    void enumerate_fake( int devices, int sub_devices, uint32_t queues_per_slot = 4 );
+    bool is_enumerated() const { return !slots.empty(); }
+    bool is_fake() const { return fake; }
+    void release();
+
+    size_t size() const { return slots.size(); }
+    device_slot& slot( size_t n ) { return *slots[ n ]; }
+    size_t device_count() const { return contexts.size(); }
+
+    // Spreads consecutive zenons over the devices first and their tiles second,
+    // so a small pool still reaches every card.
+    size_t place( int zenon_index ) const { return placement[ zenon_index % placement.size() ]; }
+
+private:
+    // contexts are left to the driver at exit, call release() to destroy them earlier
+    device_topology() = default;
+
+    std::vector<std::unique_ptr<device_slot>> slots;
+    std::vector<size_t> placement;
+    std::vector<ze_context_handle_t> contexts;
+    bool fake = false;
+
+    void add_device( int device_index, ze_device_handle_t device, ze_context_handle_t context, const std::vector<ze_device_handle_t>& sub_devices );
+    void create_ccs_queues( device_slot& slot );
+    void build_placement();
+};
+
+// Per slot in-flight and served counters used to send a query to the least
+// loaded device.
+class device_router
+{
+public:
+    explicit device_router( size_t slot_count ) :
+        inflight( slot_count ),
+        served( slot_count )
+    {
+    }
+
+    // slots ordered from the least to the most loaded
+    std::vector<size_t> order() const;
+    void started( size_t slot ) { inflight[ slot ]++; served[ slot ]++; }
+    void finished( size_t slot ) { inflight[ slot ]--; }
+    uint32_t get_inflight( size_t slot ) const { return inflight[ slot ].load(); }
+    uint64_t get_served( size_t slot ) const { return served[ slot ].load(); }
+    size_t size() const { return inflight.size(); }
+
+private:
+    std::vector<std::atomic<uint32_t>> inflight;
+    std::vector<std::atomic<uint64_t>> served;
+};
+
+#endif
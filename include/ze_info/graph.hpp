@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef GRAPH_HPP
+#define GRAPH_HPP
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+// Network graph a zenon simulates. Text format, one statement per line, '#' starts
+// a comment:
+//
+//   node <name> <kernel> <amount> <input>[,<input>] -> <output> [after <node>[,<node>...]]
+//
+// kernel: cmp_bound - busy loop, amount is the target duration in ns
+//         mem_bound - streams memory, amount is a duration in ns (informative only,
+//                     the size comes from --mem) or a size with a kB suffix
+//         add       - add_buffers, amount is ignored
+//         copy      - copy_buffer, one input, amount is ignored
+//         set_n     - writes amount to every byte of the output
+// Tensors in1, in2, mem_in1, mem_in2 and out are the zenon's inputs and output,
+// any other name is an intermediate buffer allocated per zenon. A node runs after
+// the nodes listed in "after" and after the last earlier writer of its inputs.
+enum class graph_kernel
+{
+    cmp_bound,
+    mem_bound,
+    add,
+    copy,
+    set_n
+};
+
+enum class tensor_role
+{
+    input1,
+    input2,
+    mem_input1,
+    mem_input2,
+    output,
+    intermediate
+};
+
+struct graph_tensor
+{
+    std::string name;
+    tensor_role role;
+    // read or written by a mem_bound node, allocated with the --mem multiplier
+    bool mem_sized = false;
+};
+
+struct graph_node
+{
+    std::string name;
+    graph_kernel kernel;
+    uint64_t amount = 0;
+    // for mem_bound: per node --mem override in kB, 0 keeps the global one
+    uint32_t mem_kb = 0;
+    std::vector<int> inputs;
+    int output = -1;
+    std::vector<int> deps;
+    // graph nodes merged into this one by fuse_chains(), 1 for an unfused node
+    uint32_t fused = 1;
+};
+
+// Placement of the nodes on parallel command lists (lanes). The critical path
+// gets lane 0 to itself, the other nodes go to whichever other lane lets them
+// start first. Lanes keep the graph order, so waits only point backwards.
+struct graph_schedule
+{
+    std::vector<int> lane;
+    int lane_count = 1;
+    std::vector<int> critical_path;
+    uint64_t serial_ns = 0;
+    uint64_t critical_ns = 0;
+    uint64_t scheduled_ns = 0;
+};
+
+class network_graph
+{
+public:
+    bool parse( std::istream& in, std::string& error );
+    bool load( const std::string& file_path, std::string& error );
+    static network_graph resnet50();
+    // the add_buffers chain used when --resnet is not given
+    static network_graph chain( int length = 40 );
+
+    const std::vector<graph_node>& get_nodes() const { return nodes; }
+    const std::vector<graph_tensor>& get_tensors() const { return tensors; }
+    const std::string& get_name() const { return name; }
+    void set_name( const std::string& _name ) { name = _name; }
+    int find_tensor( const std::string& tensor_name ) const;
+
+    // nodes no other node waits for
+    std::vector<int> sinks() const;
+    // largest mem_bound size in kB, default_kb for nodes without their own
+    uint32_t max_mem_kb( uint32_t default_kb ) const;
+
+    // estimated duration used for scheduling, only cmp_bound and mem_bound have one
+    static uint64_t node_cost( const graph_node& node );
+    graph_schedule schedule( int max_lanes ) const;
+    void print_schedule( std::ostream& out, int max_lanes ) const;
+
+    // Merges linear runs of cmp_bound nodes into one launch: a node whose only
+    // dependency is the cmp_bound node right before it, with no other node
+    // waiting for that one. The durations add up, the kernel loops over its
+    // counter so the work is kept. mem_bound nodes are left alone, their size is
+    // the buffer they stream, adding sizes would grow every zenon's buffers.
+    // Returns the number of launches saved.
+    size_t fuse_chains();
+    // launches before fuse_chains()
+    size_t unfused_size() const;
+
+    // Puts set_n nodes writing constant values to in1 and in2 in front of the
+    // graph, for runs without the copy engine uploading real inputs.
+    void prepend_input_init();
+
+private:
+    std::string name;
+    std::vector<graph_node> nodes;
+    std::vector<graph_tensor> tensors;
+    std::map<std::string, int> node_index;
+
+    int tensor( const std::string& tensor_name );
+};
+
+extern std::string graph_file;
+extern bool fuse_kernels;
+
+// Graph every zenon runs: --graph file if given, else the built in resnet50 or
+// chain. Loaded on the first call; returns nullptr and prints why if the file is
+// broken.
+const network_graph* get_network_graph();
+// The same graph without --fuse, to measure what fusion saves; the graph itself
+// when fusion is off.
+const network_graph* get_unfused_network_graph();
+
+#endif
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef GRAPH_TEMPLATE_HPP
+#define GRAPH_TEMPLATE_HPP
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "ze_info/graph.hpp"
+
+// Everything a kernel launch needs that does not depend on the zenon running
+// it. Tensors and events are indices, bound to the zenon's own buffers and
+// event pool when it appends the launch.
+struct launch_record
+{
+    std::string name;
+    graph_kernel kernel;
+    std::vector<int> inputs;
+    int output;
+    bool has_counter;
+    int counter;
+    // cmp_bound: the duration the counter stands for, zenons turn it into their
+    // device's counter; counter holds the default model's
+    double target_ns = 0.0;
+    std::vector<int> waits;
+};
+
+// The graph recorded once per process: launch arguments, wait lists, lane
+// placement and the compiled module IL. Every zenon instantiates it with its
+// buffers and events instead of redoing the work.
+class graph_template
+{
+public:
+    // built on first use from the current options, they must be parsed by then
+    static const graph_template& get();
+    // the graph without --fuse, get() itself when fusion is off
+    static const graph_template& get_unfused();
+
+    const network_graph& get_graph() const { return *graph; }
+    const std::vector<launch_record>& get_launches() const { return launches; }
+    const std::vector<int>& get_sinks() const { return sinks; }
+    // lane of every node for 1 to max_lanes lanes
+    const std::vector<int>& get_lanes( size_t lane_count ) const;
+    size_t max_lanes() const { return lanes.size(); }
+    uint32_t event_count() const { return (uint32_t)launches.size() + ( sinks.size() > 1 ? 1 : 0 ); }
+    uint32_t completion_index() const { return sinks.size() > 1 ? event_count() - 1 : (uint32_t)sinks[ 0 ]; }
+    int get_threads() const { return threads; }
+    int get_input_size() const { return input_bytes; }
+    const std::vector<uint8_t>& get_spirv() const { return spirv; }
+    // -D defines the module was specialized with, empty for the generic one
+    const std::string& get_build_options() const { return build_options; }
+    double get_build_ms() const { return build_ms; }
+
+private:
+    explicit graph_template( const network_graph* _graph );
+
+    const network_graph* graph;
+    std::vector<launch_record> launches;
+    std::vector<int> sinks;
+    std::vector<std::vector<int>> lanes;
+    int threads = 0;
+    int input_bytes = 0;
+    std::vector<uint8_t> spirv;
+    std::string build_options;
+    double build_ms = 0.0;
+};
+
+#endif
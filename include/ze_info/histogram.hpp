@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+// Log-bucketed (HDR-style) latency histogram. Values below sub_bucket_count are
+// stored exactly, above that every power of two is split into half_count linear
+// sub-buckets, which keeps the relative error under 1 / half_count.
+// Recording is not synchronized - keep one instance per thread and merge().
+class latency_histogram
+{
+public:
+    static const int sub_bucket_bits = 7;
+    static const uint64_t sub_bucket_count = 1ull << sub_bucket_bits;
+    static const uint64_t half_count = sub_bucket_count / 2;
+
+    // values are recorded in nanoseconds, reported in microseconds
+    latency_histogram() : counts( sub_bucket_count + ( 64 - sub_bucket_bits ) * half_count, 0 ) {}
+
+    void record( double us )
+    {
+        uint64_t value = us <= 0.0 ? 0 : (uint64_t)( us * 1000.0 );
+        counts[ bucket_index( value ) ]++;
+        total++;
+        sum += value;
+        min_value = std::min( min_value, value );
+        max_value = std::max( max_value, value );
+    }
+
+    void merge( const latency_histogram& other )
+    {
+        for( size_t i = 0; i < counts.size(); i++ )
+            counts[ i ] += other.counts[ i ];
+        total += other.total;
+        sum += other.sum;
+        min_value = std::min( min_value, other.min_value );
+        max_value = std::max( max_value, other.max_value );
+    }
+
+    uint64_t count() const { return total; }
+    double min() const { return total ? min_value / 1000.0 : 0.0; }
+    double max() const { return total ? max_value / 1000.0 : 0.0; }
+    double avg() const { return total ? (double)sum / total / 1000.0 : 0.0; }
+
+    // p in [0, 100]; returns the midpoint of the bucket holding the p-th sample,
+    // clamped to the exact min/max
+    double percentile( double p ) const
+    {
+        if( !total )
+            return 0.0;
+        uint64_t rank = (uint64_t)( p / 100.0 * total + 0.5 );
+        rank = std::max<uint64_t>( 1, std::min( rank, total ) );
+        uint64_t seen = 0;
+        for( size_t i = 0; i < counts.size(); i++ )
+        {
+            seen += counts[ i ];
+            if( seen >= rank )
+            {
+                uint64_t mid = bucket_lower( i ) + ( bucket_upper( i ) - bucket_lower( i ) ) / 2;
+                mid = std::max( min_value, std::min( mid, max_value ) );
+                return mid / 1000.0;
+            }
+        }
+        return max();
+    }
+
+    // one "lower_ns upper_ns count" line per non-empty bucket
+    void export_buckets( std::ostream& out ) const
+    {
+        out << "# lower_ns upper_ns count\n";
+        for( size_t i = 0; i < counts.size(); i++ )
+        {
+            if( counts[ i ] )
+                out << bucket_lower( i ) << " " << bucket_upper( i ) << " " << counts[ i ] << "\n";
+        }
+    }
+
+    bool export_buckets( const std::string& file_path ) const
+    {
+        std::ofstream out( file_path );
+        if( !out )
+            return false;
+        export_buckets( out );
+        return true;
+    }
+
+private:
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t min_value = std::numeric_limits<uint64_t>::max();
+    uint64_t max_value = 0;
+
+    static int msb( uint64_t v )
+    {
+        int r = 0;
+        while( v >>= 1 )
+            r++;
+        return r;
+    }
+
+    static size_t bucket_index( uint64_t value )
+    {
+        if( value < sub_bucket_count )
+            return (size_t)value;
+        int shift = msb( value ) - ( sub_bucket_bits - 1 );
+        return (size_t)( sub_bucket_count + ( shift - 1 ) * half_count + ( ( value >> shift ) - half_count ) );
+    }
+
+    static uint64_t bucket_lower( size_t index )
+    {
+        if( index < sub_bucket_count )
+            return index;
+        uint64_t shift = ( index - sub_bucket_count ) / half_count + 1;
+        uint64_t sub = ( index - sub_bucket_count ) % half_count + half_count;
+        return sub << shift;
+    }
+
+    static uint64_t bucket_upper( size_t index )
+    {
+        if( index < sub_bucket_count )
+            return index;
+        uint64_t shift = ( index - sub_bucket_count ) / half_count + 1;
+        return bucket_lower( index ) + ( 1ull << shift ) - 1;
+    }
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef HOST_BUFFER_POOL_HPP
+#define HOST_BUFFER_POOL_HPP
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include "ze_api.h"
+#include "boost/lockfree/queue.hpp"
+
+// The inputs of one query in USM host memory. The copy engine reads them
+// directly, no pageable staging copy in between.
+struct host_payload
+{
+    uint8_t* input1 = nullptr;
+    uint8_t* input2 = nullptr;
+    uint8_t* mem_input1 = nullptr;
+    uint8_t* mem_input2 = nullptr;
+    size_t input_bytes = 0;
+    size_t mem_bytes = 0;
+    // device_topology slot whose context the payload is registered with
+    size_t slot = 0;
+};
+
+// Payloads registered once with a context and handed out to queries: the
+// caller writes its data into a payload, the zenon uploads from it and the
+// payload goes back to the pool once the query is done.
+class host_buffer_pool
+{
+public:
+    host_buffer_pool( ze_context_handle_t _context, size_t slot, size_t count, size_t input_bytes, size_t mem_bytes );
+    ~host_buffer_pool();
+
+    host_payload* acquire();
+    void release( host_payload* payload );
+
+    size_t size() const { return payloads.size(); }
+    uint64_t get_waits() const { return waits.load(); }
+    size_t registered_bytes() const;
+
+private:
+    ze_context_handle_t context;
+    std::vector<host_payload> payloads;
+    boost::lockfree::queue<host_payload*> free_payloads;
+    std::atomic<uint64_t> waits{ 0 };
+};
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef KERNEL_PROBE_HPP
+#define KERNEL_PROBE_HPP
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "ze_api.h"
+#include "ze_info/device_topology.hpp"
+
+// One module.cl kernel with buffers of its own, launched alone on an immediate
+// list of the slot and timed with a kernel timestamp event. Works for the two
+// input kernels, with a counter argument (cmp_bound_kernel, mem_bound_kernel,
+// set_n_to_output) or without (add_buffers, mul_buffers).
+class kernel_probe
+{
+public:
+    kernel_probe( const device_slot& slot, const std::vector<uint8_t>& spirv, const char* kernel_name, bool has_counter,
+        int threads, int input_size, size_t buffer_bytes );
+    ~kernel_probe();
+
+    // median kernel duration in ns of a few launches, after a warm up one
+    double measure( int counter, int runs = 5 );
+
+private:
+    ze_context_handle_t context;
+    bool has_counter;
+    int threads, input_size;
+    uint64_t timer_resolution = 1;
+    ze_module_handle_t module = nullptr;
+    ze_kernel_handle_t kernel = nullptr;
+    void* buffers[ 3 ] = {};
+    ze_event_pool_handle_t event_pool = nullptr;
+    ze_event_handle_t event = nullptr;
+    ze_command_list_handle_t list = nullptr;
+};
+
+#endif
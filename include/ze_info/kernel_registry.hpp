@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef KERNEL_REGISTRY_HPP
+#define KERNEL_REGISTRY_HPP
+#include <iostream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "ze_api.h"
+#include "ze_info/graph.hpp"
+
+const int graph_kernel_count = (int)graph_kernel::set_n + 1;
+
+// The module of one context and device and a kernel of every graph_kernel kind
+// created from it. Arguments set on the kernels are shared too: whoever binds
+// them and appends a launch holds mtx for it.
+struct kernel_set
+{
+    ze_context_handle_t context = nullptr;
+    ze_device_handle_t device = nullptr;
+    ze_module_handle_t module = nullptr;
+    ze_kernel_handle_t kernels[ graph_kernel_count ] = {};
+    uint32_t users = 0;
+    std::mutex mtx;
+
+    ze_kernel_handle_t get( graph_kernel kind ) const { return kernels[ (int)kind ]; }
+};
+
+// Modules shared by every zenon of a context and device instead of one per
+// zenon. A zenon that appends launches while others run (--immediate) creates
+// kernels of its own from the shared module with create_kernels(), a kernel
+// is only the argument state, the module holds the code.
+class kernel_registry
+{
+public:
+    static kernel_registry& get();
+
+    // the set of the context and device, created with the spirv on first use
+    kernel_set& acquire( ze_context_handle_t context, ze_device_handle_t device, const std::vector<uint8_t>& spirv );
+    // destroys the set with its last user
+    void release( kernel_set& set );
+
+    static void create_kernels( ze_module_handle_t module, ze_kernel_handle_t* kernels );
+    static void destroy_kernels( ze_kernel_handle_t* kernels );
+
+    // startup cost of a zenon's module and kernels, host resident memory and time
+    void record_zenon( int64_t rss_bytes, uint64_t ns );
+    void print_stats( std::ostream& out ) const;
+
+    // resident set size of the process, 0 where it is not known
+    static int64_t resident_bytes();
+
+private:
+    std::mutex mtx;
+    std::map<std::pair<ze_context_handle_t, ze_device_handle_t>, std::unique_ptr<kernel_set>> sets;
+
+    std::atomic<uint32_t> modules_created{ 0 };
+    std::atomic<int64_t> module_rss_bytes{ 0 };
+    std::atomic<uint64_t> module_ns{ 0 };
+    std::atomic<uint64_t> native_bytes{ 0 };
+    std::atomic<uint32_t> zenons{ 0 };
+    std::atomic<int64_t> zenon_rss_bytes{ 0 };
+    std::atomic<uint64_t> zenon_ns{ 0 };
+};
+
+#endif
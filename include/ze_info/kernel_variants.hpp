@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef KERNEL_VARIANTS_HPP
+#define KERNEL_VARIANTS_HPP
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <cstdint>
+#include "ze_info/device_topology.hpp"
+
+// SPIR-V of module.cl per set of build options, compiled on first request. ""
+// is the generic module, specialized ones fix sizes with -D defines (see the top
+// of module.cl).
+class kernel_variants
+{
+public:
+    static kernel_variants& get();
+
+    // empty when the options do not compile
+    const std::vector<uint8_t>& spirv( const std::string& options );
+    size_t size() const;
+
+    // -D defines fixing the batch threads, input bytes and, when every mem_bound
+    // launch uses the same one, the mem_bound_kernel counter
+    static std::string specialization_options( int threads, int input_size, int mem_kb );
+
+private:
+    mutable std::mutex mtx;
+    std::map<std::string, std::vector<uint8_t>> modules;
+};
+
+class graph_template;
+
+// --profiling: times the graph's kernels from the generic and the specialized
+// module on one slot, side by side.
+void compare_kernel_variants( const device_slot& slot, const graph_template& recorded, std::ostream& out );
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef MEMORY_PLANNER_HPP
+#define MEMORY_PLANNER_HPP
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "ze_info/graph.hpp"
+
+// Offsets of the intermediate tensors of a graph inside one arena.
+struct memory_plan
+{
+    // byte offset of every tensor, indexed like network_graph::get_tensors();
+    // not_planned for tensors outside the arena (inputs, output, unused ones)
+    std::vector<size_t> offsets;
+    size_t arena_size = 0;
+    // one buffer per intermediate tensor, what allocating them separately takes
+    size_t naive_size = 0;
+
+    static constexpr size_t not_planned = SIZE_MAX;
+};
+
+// Packs the intermediate tensors into one arena, first fit in the order they
+// appear in the graph. Two tensors may share bytes only if every node using one
+// of them is ordered before every node using the other through the
+// dependencies - graph order alone is not enough once branches run on separate
+// command lists. sizes holds the byte size of every tensor.
+memory_plan plan_intermediates( const network_graph& graph, const std::vector<size_t>& sizes, size_t alignment = 64 );
+
+#endif
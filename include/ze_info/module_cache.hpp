@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef MODULE_CACHE_HPP
+#define MODULE_CACHE_HPP
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "ze_api.h"
+
+// A read only file mapped into memory (read into a buffer where mmap is not
+// available). Empty when the file does not exist.
+class mapped_file
+{
+public:
+    explicit mapped_file( const std::string& path );
+    ~mapped_file();
+    mapped_file( const mapped_file& ) = delete;
+    mapped_file& operator=( const mapped_file& ) = delete;
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::vector<uint8_t> buffer;
+};
+
+// Content addressed cache of compiled module.cl in --module_cache (default
+// ./module_cache). SPIR-V is keyed by a hash of the source, the build options
+// and the ocloc target, native binaries by a hash of the SPIR-V and the device.
+// Files are written once under their hash and never change, so a hit needs no
+// validation beyond the driver accepting the binary.
+class module_cache
+{
+public:
+    static module_cache& get();
+
+    // SPIR-V of the source with the options, compile() runs on a miss
+    template <typename F>
+    std::vector<uint8_t> spirv( const std::string& source, const std::string& options, const std::string& target, F&& compile )
+    {
+        const std::string path = file_path( hash_key( { source, options, target } ), ".spv" );
+        if( enabled() )
+        {
+            mapped_file cached( path );
+            if( !cached.empty() )
+            {
+                spirv_hits++;
+                return std::vector<uint8_t>( cached.data(), cached.data() + cached.size() );
+            }
+        }
+        spirv_misses++;
+        std::vector<uint8_t> compiled = compile();
+        if( enabled() && !compiled.empty() )
+            store( path, compiled.data(), compiled.size() );
+        return compiled;
+    }
+
+    // Module for the device from its native binary when one is cached, from the
+    // SPIR-V otherwise, then saving the binary the driver built.
+    ze_module_handle_t create_module( ze_context_handle_t context, ze_device_handle_t device, const std::vector<uint8_t>& spirv );
+
+    bool enabled() const { return !directory.empty(); }
+    void print_stats( std::ostream& out ) const;
+
+    static uint64_t fnv1a( const void* data, size_t size, uint64_t hash = 14695981039346656037ull );
+
+private:
+    std::string directory;
+    std::mutex mtx;
+    // native binaries stay mapped for the zenons after the first
+    std::map<std::string, std::unique_ptr<mapped_file>> binaries;
+
+    std::atomic<uint64_t> spirv_hits{ 0 }, spirv_misses{ 0 };
+    std::atomic<uint64_t> native_hits{ 0 }, native_misses{ 0 };
+    std::atomic<uint64_t> create_count{ 0 }, create_ns_total{ 0 }, create_ns_max{ 0 };
+
+    module_cache();
+    static std::string hash_key( std::initializer_list<std::string> parts );
+    std::string file_path( const std::string& key, const char* extension ) const;
+    void store( const std::string& path, const uint8_t* data, size_t size );
+};
+
+#endif
@@ -18,6 +18,8 @@
 
 
         std::vector<uint8_t> generate_spirv(const std::string& cl_file_path, const std::string& build_options);
+        // ocloc -device the SPIR-V is compiled for
+        extern const char* const ocloc_device;
 
 	
 #endif
\ No newline at end of file
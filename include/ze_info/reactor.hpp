@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef REACTOR_HPP
+#define REACTOR_HPP
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include "ze_info/zenon.hpp"
+
+struct inflight_query
+{
+    int qid;
+    zenon* zenek;
+    std::chrono::high_resolution_clock::time_point intended_time;
+    // --zero_copy: the caller's payload the query uploads from
+    host_payload* payload;
+};
+
+// Completion reactor for the single thread client. Watches the terminal event of
+// every in-flight zenon, spinning for a bounded number of sweeps and then
+// blocking on the oldest query in short slices, and hands each finished query to
+// the callback as soon as it is seen, regardless of its pool slot.
+class completion_reactor
+{
+public:
+    completion_reactor( int _spin_sweeps = 64, std::chrono::microseconds _block_slice = std::chrono::microseconds( 100 ) ) :
+        spin_sweeps( _spin_sweeps ),
+        block_slice( _block_slice )
+    {
+    }
+
+    void add( int qid, zenon* zenek, std::chrono::high_resolution_clock::time_point intended_time, host_payload* payload = nullptr )
+    {
+        inflight.push_back( { qid, zenek, intended_time, payload } );
+    }
+
+    size_t size() const { return inflight.size(); }
+    bool empty() const { return inflight.empty(); }
+    uint64_t get_sweeps() const { return sweeps; }
+    uint64_t get_blocks() const { return blocks; }
+
+    // Waits until at least one query completes or the deadline passes (the next
+    // arrival the caller has to issue). Returns the number of completed queries.
+    template <typename F>
+    int wait( F&& on_complete, std::chrono::high_resolution_clock::time_point deadline )
+    {
+        using namespace std::chrono;
+        int done = 0;
+        for( int spin = 0; spin < spin_sweeps; spin++ )
+        {
+            done = poll( on_complete );
+            if( done || high_resolution_clock::now() >= deadline )
+                return done;
+        }
+        while( !inflight.empty() )
+        {
+            high_resolution_clock::time_point now = high_resolution_clock::now();
+            if( now >= deadline )
+                return poll( on_complete );
+            auto slice = std::min<high_resolution_clock::duration>( block_slice, deadline - now );
+            blocks++;
+            inflight.front().zenek->wait_finished( (uint64_t)duration_cast<nanoseconds>( slice ).count() );
+            done = poll( on_complete );
+            if( done )
+                return done;
+        }
+        return done;
+    }
+
+private:
+    std::vector<inflight_query> inflight;
+    int spin_sweeps;
+    std::chrono::microseconds block_slice;
+    uint64_t sweeps = 0;
+    uint64_t blocks = 0;
+
+    template <typename F>
+    int poll( F& on_complete )
+    {
+        int done = 0;
+        sweeps++;
+        for( size_t i = 0; i < inflight.size(); )
+        {
+            if( inflight[ i ].zenek->is_finished() )
+            {
+                inflight_query q = inflight[ i ];
+                inflight.erase( inflight.begin() + i );
+                on_complete( q );
+                done++;
+            }
+            else
+                i++;
+        }
+        return done;
+    }
+};
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef SCENARIO_HPP
+#define SCENARIO_HPP
+#include <string>
+
+// Load patterns modelled after the MLPerf inference scenarios.
+//  single_stream - closed loop, next query is sent when the previous one is done;
+//                  metric: p90 latency
+//  multi_stream  - a query of samples_per_query samples every multi_stream_interval_us;
+//                  metric: p99 query latency must fit in the interval
+//  server        - Poisson arrivals at --qps; metric: p99 latency within latency_target_us
+//  offline       - every query is sent at once; metric: throughput
+enum class scenario_type
+{
+    single_stream,
+    multi_stream,
+    server,
+    offline
+};
+
+bool parse_scenario( const std::string& name, scenario_type& scenario );
+const char* to_string( scenario_type scenario );
+
+#endif
@@ -16,31 +16,120 @@
 #include <deque>
 #include <mutex>
 #include <algorithm>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <condition_variable>
 #include "ze_info/zenon.hpp"
-#include <memory>
-#include "boost/lockfree/queue.hpp"
+#include "ze_info/zenon_pool.hpp"
+#include "ze_info/host_buffer_pool.hpp"
+#include "ze_info/device_topology.hpp"
+#include "ze_info/calibration.hpp"
+#include "ze_info/kernel_variants.hpp"
+#include "ze_info/module_cache.hpp"
+#include "ze_info/kernel_registry.hpp"
+#include "tbb/concurrent_priority_queue.h"
+
+extern pool_wait_strategy pool_wait;
+extern int max_batch_size;
+extern int max_batch_wait_us;
+extern int deadline_us;
+extern bool zero_copy;
+extern bool disable_blitter;
+extern bool cpu_backend;
+extern bool overlap_copies;
 
 class server
 {
 public:
     server(int pool_size, bool multi_ccs, bool log = false) :
         log_lock(mtx, std::defer_lock),
-        logging(log)
+        logging(log),
+        router(enumerate_devices(log))
     {
-        zenek.resize(pool_size);
-        zenek_pool_boost.reserve(pool_size);
+        device_topology& topology = device_topology::get();
+        // --overlap: every zenon gets a twin with the second buffer set, both in
+        // the pool, so the twin uploads the next query while the zenon computes
+        const int buffer_sets = overlap_copies && !disable_blitter ? 2 : 1;
+        zenek.resize(pool_size * buffer_sets);
+        service_start.resize(zenek.size());
+        slot_capacity.resize(topology.size(), 0);
         for (int i = 0; i < pool_size; i++)
+            slot_capacity[topology.place(i)]++;
+        for (size_t n = 0; n < topology.size(); n++)
+            zenek_pools.emplace_back(new zenon_pool(std::max<uint32_t>(1, slot_capacity[n] * buffer_sets), pool_wait));
+        // the graph template is built and the devices calibrated inside the startup
+        // window, both are taken out of the per zenon figure
+        auto startup = std::chrono::high_resolution_clock::now();
+        const graph_template& recorded = graph_template::get();
+        double calibration_ms = 0;
+        // the zenons record their cmp_bound counters from the device's model
+        if (!cpu_backend && !topology.is_fake())
+        {
+            auto calibration = std::chrono::high_resolution_clock::now();
+            calibrate_devices(topology, recorded, std::cout);
+            calibration_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - calibration).count();
+        }
+        for (size_t i = 0; i < zenek.size(); i++)
         {
-            zenek[i] = new zenon(i, multi_ccs, log);
+            size_t slot = topology.place(i % pool_size);
+            zenek[i] = new zenon(i, multi_ccs, log, slot);
+            if (i >= (size_t)pool_size)
+                zenek[i]->share_intermediates(*zenek[i - pool_size]);
             zenek[i]->create_module();
             zenek[i]->allocate_buffers();
             zenek[i]->create_cmd_list();
-            zenek_pool_boost.push(zenek[i]);
+            zenek_pools[slot]->release(zenek[i]);
+        }
+        double startup_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startup).count();
+        std::cout << "Pool startup: " << zenek.size() << " zenons in " << startup_ms << " ms \t graph template: " << recorded.get_build_ms()
+                  << " ms \t calibration: " << calibration_ms << " ms \t per zenon: "
+                  << (pool_size ? (startup_ms - recorded.get_build_ms() - calibration_ms) / zenek.size() : 0.0) << " ms\n";
+        if (!cpu_backend)
+        {
+            std::cout << "Kernel module: " << (recorded.get_build_options().empty() ? "generic" : recorded.get_build_options()) << "\n";
+            module_cache::get().print_stats(std::cout);
+            kernel_registry::get().print_stats(std::cout);
+        }
+        // batches are written into the zenon's own vectors
+        if (zero_copy && !disable_blitter && max_batch_size <= 1 && pool_size)
+        {
+            // two payloads per zenon, the caller can fill the next while one uploads
+            size_t registered = 0;
+            for (size_t n = 0; n < topology.size(); n++)
+            {
+                payload_pools.emplace_back(new host_buffer_pool(topology.slot(n).context, n, 2 * slot_capacity[n] * buffer_sets,
+                    zenek[0]->get_input1()->size(), zenek[0]->get_mem_input1()->size()));
+                registered += payload_pools.back()->registered_bytes();
+            }
+            std::cout << "Zero copy: " << 2 * zenek.size() << " payloads registered as USM host memory \t " << registered / 1024 << " kB\n";
+        }
+        if (pool_size)
+        {
+            size_t used = 0;
+            for (int i = 0; i < pool_size; i++)
+                used += zenek[i]->get_intermediate_bytes();
+            std::cout << "Intermediate memory per zenon: " << zenek[0]->get_naive_intermediate_bytes() / 1024 << " kB separate, "
+                      << zenek[0]->get_intermediate_bytes() / 1024 << " kB used \t pool: " << used / 1024 << " kB\n";
         }
+        if (max_batch_size > 1)
+        {
+            batch_size_counts.resize(max_batch_size + 1, 0);
+            for (size_t i = 0; i < zenek.size(); i++)
+                batch_dispatchers.emplace_back(&server::batch_dispatch_loop, this);
+        }
+    }
+
+    ~server()
+    {
+        stop_batching();
     }
 
     gpu_results query_sample_multiple_threads( int id )
     {
+        if (max_batch_size > 1)
+            return query_sample_batched( id );
+
         zenon* zenek = get_zenon_atomic();
         int zen_id = zenek->get_id();
         std::vector<uint8_t>* in1 = zenek->get_input1();
@@ -64,6 +153,7 @@ public:
     {
         zenon* zenek = get_zenon_atomic();
         int zen_id = zenek->get_id();
+        service_start[zen_id] = std::chrono::high_resolution_clock::now();
         std::vector<uint8_t>* in1 = zenek->get_input1();
         std::vector<uint8_t>* in2 = zenek->get_input2();
         std::fill(in1->begin(), in1->end(), id);
@@ -82,34 +172,380 @@ public:
 
     bool is_finished( int id, zenon* zenek )
     {
-        return zenek->is_finished( id );
+        return zenek->is_finished();
     }
 
     gpu_results get_result( int id, zenon* zenek )
     {
         gpu_results res = zenek->get_result( id );
+        record_service_time( std::chrono::high_resolution_clock::now() - service_start[ zenek->get_id() ] );
+        // the caller releases its payload once it has the result
+        zenek->set_payload( nullptr );
         return_zenon_atomic( zenek );
         return res;
     }
 
+    // Admission check: false when, given the current service time estimate, a
+    // query started now would finish after its deadline.
+    bool can_meet_deadline( std::chrono::high_resolution_clock::time_point deadline )
+    {
+        auto expected = std::chrono::nanoseconds( service_ewma_ns.load() );
+        return std::chrono::high_resolution_clock::now() + expected <= deadline;
+    }
+
+    // Earliest deadline first: the query waits in a priority queue ordered by
+    // deadline (then priority) and gets the next free zenon when it is at the
+    // top. Returns false if the query was shed because it could not meet its
+    // deadline anymore, either at admission or when it reached the top.
+    bool query_sample_deadline( int id, std::chrono::high_resolution_clock::time_point deadline, int priority, gpu_results& gpu_result )
+    {
+        if( !can_meet_deadline( deadline ) )
+        {
+            shed_at_admission++;
+            return false;
+        }
+        edf_request request;
+        request.id = id;
+        request.priority = priority;
+        request.deadline = deadline;
+        request.seq = edf_seq++;
+        std::future<zenon*> assigned = request.assigned.get_future();
+        edf_queue.push( &request );
+        schedule_edf();
+
+        zenon* zenek = assigned.get();
+        if( !zenek )
+            return false;
+
+        int zen_id = zenek->get_id();
+        std::vector<uint8_t>* in1 = zenek->get_input1();
+        std::vector<uint8_t>* in2 = zenek->get_input2();
+        std::vector<uint8_t>* mem_in1 = zenek->get_mem_input1();
+        std::vector<uint8_t>* mem_in2 = zenek->get_mem_input2();
+        std::fill( in1->begin(), in1->end(), id );
+        std::fill( in2->begin(), in2->end(), id - 1 );
+        std::fill( mem_in1->begin(), mem_in1->end(), id );
+        std::fill( mem_in2->begin(), mem_in2->end(), id - 1 );
+        auto start = std::chrono::high_resolution_clock::now();
+        gpu_result = zenek->run( id );
+        record_service_time( std::chrono::high_resolution_clock::now() - start );
+        return_zenon_atomic( zenek );
+        schedule_edf();
+        log( "sample id:", id );
+        log( "will use zenek no:", zen_id );
+        return true;
+    }
+
+    // with --overlap the twins too, how many queries can be in flight
+    int get_zenon_count() const { return (int)zenek.size(); }
+
+    uint64_t get_shed_count() const { return shed_at_admission.load() + shed_in_queue.load(); }
+
+    void print_shed_stats()
+    {
+        if( deadline_us <= 0 )
+            return;
+        std::cout << "Load shedding: deadline: " << deadline_us << " us \t rejected at admission: " << shed_at_admission.load()
+            << " \t dropped from queue: " << shed_in_queue.load()
+            << " \t service estimate: " << service_ewma_ns.load() / 1000.0 << " us\n";
+    }
+
+    // Queues the query for the batching stage and blocks until the batch it
+    // was put in has finished. The caller's thread is held for the whole batch,
+    // so batches only fill when the client issues from max_batch_size threads
+    // per zenon (client::issue_threads).
+    gpu_results query_sample_batched( int id )
+    {
+        batch_request request;
+        request.id = id;
+        request.arrival = std::chrono::high_resolution_clock::now();
+        std::future<gpu_results> result = request.done.get_future();
+        {
+            std::lock_guard<std::mutex> lock( batch_mtx );
+            pending_requests.push_back( &request );
+        }
+        batch_cv.notify_all();
+        return result.get();
+    }
+
+    void print_pool_stats()
+    {
+        device_topology& topology = device_topology::get();
+        for (size_t n = 0; n < zenek_pools.size(); n++)
+        {
+            if (!slot_capacity[n])
+                continue;
+            std::cout << topology.slot(n).name() << ": zenons: " << slot_capacity[n] << " \t queries: " << router.get_served(n) << "\n  ";
+            zenek_pools[n]->print_stats(std::cout);
+            if (n < payload_pools.size())
+                std::cout << "  payloads: " << payload_pools[n]->size() << " \t waited: " << payload_pools[n]->get_waits() << "\n";
+        }
+    }
+
+    // --zero_copy, the caller's side: a payload registered with the context of the
+    // least loaded slot, nullptr without --zero_copy. The caller writes the whole
+    // query into it, passes it to query_sample and gives it back with
+    // release_payload once it has the result.
+    host_payload* acquire_payload()
+    {
+        if (payload_pools.empty())
+            return nullptr;
+        for (size_t n : router.order())
+        {
+            if (slot_capacity[n])
+                return payload_pools[n]->acquire();
+        }
+        return nullptr;
+    }
+
+    void release_payload(host_payload* payload)
+    {
+        payload_pools[payload->slot]->release(payload);
+    }
+
+    // Runs the query on a zenon of the payload's slot, the upload reads the
+    // payload in place instead of the zenon's own vectors.
+    gpu_results query_sample_multiple_threads(const host_payload& payload, int id)
+    {
+        zenon* zenek = get_zenon_atomic(payload.slot);
+        int zen_id = zenek->get_id();
+        zenek->set_payload(&payload);
+        gpu_results gpu_result = zenek->run(id);
+        int ccs_id = zenek->get_ccs_id();
+        zenek->set_payload(nullptr);
+        return_zenon_atomic(zenek);
+        log("sample id:", id);
+        log("will use zenek no:", zen_id);
+        log("with ccs: ", ccs_id);
+        return gpu_result;
+    }
+
+    zenon* query_sample(const host_payload& payload, int id)
+    {
+        zenon* zenek = get_zenon_atomic(payload.slot);
+        int zen_id = zenek->get_id();
+        service_start[zen_id] = std::chrono::high_resolution_clock::now();
+        zenek->set_payload(&payload);
+        zenek->run(id);
+        log("sample id:", id);
+        log("will use zenek no:", zen_id);
+        log("with ccs: ", zenek->get_ccs_id());
+        return zenek;
+    }
+
+    void print_ccs_stats(double wall_ms)
+    {
+        device_topology& topology = device_topology::get();
+        std::cout << "CCS utilization:\n";
+        for (size_t n = 0; n < topology.size(); n++)
+        {
+            if (slot_capacity[n])
+                topology.slot(n).print_ccs_stats(std::cout, wall_ms);
+        }
+    }
+
+    void print_batch_stats()
+    {
+        if (max_batch_size <= 1)
+            return;
+        uint64_t batches = 0, batched = 0;
+        for (size_t i = 0; i < batch_size_counts.size(); i++)
+        {
+            batches += batch_size_counts[i];
+            batched += batch_size_counts[i] * i;
+        }
+        std::cout << "Batching: max batch: " << max_batch_size << " \t max wait: " << max_batch_wait_us << " us \t batches: " << batches
+            << " \t avg batch: " << (batches ? (double)batched / batches : 0.0) << "\n";
+        std::cout << "Batch sizes:       ";
+        for (size_t i = 1; i < batch_size_counts.size(); i++)
+            std::cout << " " << i << ": " << batch_size_counts[i];
+        std::cout << "\n";
+    }
+
     void delete_zenek()
     {
+        stop_batching();
         for (int i = 1; i < zenek_pool_size; i++) {
             delete zenek[i];
         }
     }
 
 private:
+    struct edf_request
+    {
+        int id;
+        int priority;
+        uint64_t seq;
+        std::chrono::high_resolution_clock::time_point deadline;
+        std::promise<zenon*> assigned;
+    };
+
+    // "less urgent than": the top of the queue has the earliest deadline,
+    // then the highest priority, then the earliest arrival
+    struct edf_order
+    {
+        bool operator()( const edf_request* a, const edf_request* b ) const
+        {
+            if( a->deadline != b->deadline )
+                return a->deadline > b->deadline;
+            if( a->priority != b->priority )
+                return a->priority < b->priority;
+            return a->seq > b->seq;
+        }
+    };
+
+    struct batch_request
+    {
+        int id;
+        std::chrono::high_resolution_clock::time_point arrival;
+        std::promise<gpu_results> done;
+        std::vector<uint8_t> output;
+    };
+
     bool logging = false;
     std::mutex mtx;
     std::unique_lock<std::mutex> log_lock;
     int zenek_pool_size = 0;
-    std::deque<std::shared_ptr<zenon>> zenek_pool;
     std::vector<zenon*> zenek;
+    // one pool of free zenons per device_topology slot
+    std::vector<std::unique_ptr<zenon_pool>> zenek_pools;
+    // --zero_copy payloads per slot, and the one each zenon is running from
+    std::vector<std::unique_ptr<host_buffer_pool>> payload_pools;
+    std::vector<uint32_t> slot_capacity;
+    device_router router;
+
+    static size_t enumerate_devices(bool log)
+    {
+        device_topology& topology = device_topology::get();
+        if (!topology.is_enumerated())
+            topology.enumerate(log);
+        return topology.size();
+    }
+
+    tbb::concurrent_priority_queue<edf_request*, edf_order> edf_queue;
+    std::mutex edf_mtx;
+    std::atomic<uint64_t> edf_seq{ 0 };
+    std::atomic<uint64_t> shed_at_admission{ 0 };
+    std::atomic<uint64_t> shed_in_queue{ 0 };
+    std::atomic<uint64_t> service_ewma_ns{ 0 };
+    std::vector<std::chrono::high_resolution_clock::time_point> service_start;
+
+    // Hands free zenons to the most urgent queued queries. Runs under edf_mtx, so
+    // whichever of a new arrival or a released zenon comes last does the hand off.
+    void schedule_edf()
+    {
+        std::lock_guard<std::mutex> lock( edf_mtx );
+        zenon* zenek;
+        edf_request* request;
+        while( !edf_queue.empty() && try_zenon( zenek ) )
+        {
+            bool assigned = false;
+            while( edf_queue.try_pop( request ) )
+            {
+                if( can_meet_deadline( request->deadline ) )
+                {
+                    request->assigned.set_value( zenek );
+                    assigned = true;
+                    break;
+                }
+                shed_in_queue++;
+                request->assigned.set_value( nullptr );
+            }
+            if( !assigned )
+            {
+                return_zenon_atomic( zenek );
+                break;
+            }
+        }
+    }
+
+    void record_service_time( std::chrono::high_resolution_clock::duration duration )
+    {
+        uint64_t sample = std::chrono::duration_cast<std::chrono::nanoseconds>( duration ).count();
+        uint64_t current = service_ewma_ns.load();
+        uint64_t next = current ? current - current / 8 + sample / 8 : sample;
+        while( !service_ewma_ns.compare_exchange_weak( current, next ) )
+            next = current ? current - current / 8 + sample / 8 : sample;
+    }
 
-    boost::lockfree::queue < zenon*/*, boost::lockfree::capacity<1>*/ > zenek_pool_boost;
+    std::mutex batch_mtx;
+    std::mutex batch_form_mtx;
+    std::condition_variable batch_cv;
+    std::deque<batch_request*> pending_requests;
+    std::vector<std::thread> batch_dispatchers;
+    std::vector<uint64_t> batch_size_counts;
+    bool batch_stop = false;
 
-    void log(char* msg, int a = 0)
+    // Every dispatcher forms one batch at a time: it waits for the first
+    // pending query, then for max_batch_size queries or max_batch_wait_us after
+    // the first arrival, whichever comes first, and runs the batch on a zenon.
+    void batch_dispatch_loop()
+    {
+        while (true)
+        {
+            std::vector<batch_request*> batch;
+            {
+                std::lock_guard<std::mutex> form_lock(batch_form_mtx);
+                std::unique_lock<std::mutex> lock(batch_mtx);
+                batch_cv.wait(lock, [&] { return batch_stop || !pending_requests.empty(); });
+                if (pending_requests.empty())
+                    return;
+                auto deadline = pending_requests.front()->arrival + std::chrono::microseconds(max_batch_wait_us);
+                batch_cv.wait_until(lock, deadline, [&] { return batch_stop || pending_requests.size() >= (size_t)max_batch_size; });
+                while (!pending_requests.empty() && batch.size() < (size_t)max_batch_size)
+                {
+                    batch.push_back(pending_requests.front());
+                    pending_requests.pop_front();
+                }
+                batch_size_counts[batch.size()]++;
+            }
+            run_batch(batch);
+        }
+    }
+
+    void run_batch(std::vector<batch_request*>& batch)
+    {
+        zenon* zenek = get_zenon_atomic();
+        std::vector<uint8_t>* in1 = zenek->get_input1();
+        std::vector<uint8_t>* in2 = zenek->get_input2();
+        std::vector<uint8_t>* mem_in1 = zenek->get_mem_input1();
+        std::vector<uint8_t>* mem_in2 = zenek->get_mem_input2();
+        size_t slice = in1->size() / max_batch_size;
+        size_t mem_slice = mem_in1->size() / max_batch_size;
+        // unused slices of a partial batch are left as they are
+        for (size_t b = 0; b < batch.size(); b++)
+        {
+            int id = batch[b]->id;
+            std::fill(in1->begin() + b * slice, in1->begin() + (b + 1) * slice, id);
+            std::fill(in2->begin() + b * slice, in2->begin() + (b + 1) * slice, id - 1);
+            std::fill(mem_in1->begin() + b * mem_slice, mem_in1->begin() + (b + 1) * mem_slice, id);
+            std::fill(mem_in2->begin() + b * mem_slice, mem_in2->begin() + (b + 1) * mem_slice, id - 1);
+        }
+        gpu_results gpu_result = zenek->run(batch[0]->id);
+        std::vector<uint8_t>* out = zenek->get_output();
+        for (size_t b = 0; b < batch.size(); b++)
+            batch[b]->output.assign(out->begin() + b * slice, out->begin() + (b + 1) * slice);
+        int zen_id = zenek->get_id();
+        return_zenon_atomic(zenek);
+        log("batch of:", (int)batch.size());
+        log("will use zenek no:", zen_id);
+        for (auto request : batch)
+            request->done.set_value(gpu_result);
+    }
+
+    void stop_batching()
+    {
+        {
+            std::lock_guard<std::mutex> lock(batch_mtx);
+            batch_stop = true;
+        }
+        batch_cv.notify_all();
+        for (auto& dispatcher : batch_dispatchers)
+            dispatcher.join();
+        batch_dispatchers.clear();
+    }
+
+    void log(const char* msg, int a = 0)
     {
         if (logging)
         {
@@ -119,16 +555,52 @@ private:
         }
     }
 
+    // Takes a free zenon from the least loaded device that has one.
+    bool try_zenon(zenon*& zenek)
+    {
+        for (size_t n : router.order())
+        {
+            if (slot_capacity[n] && zenek_pools[n]->try_acquire(zenek))
+            {
+                router.started(n);
+                return true;
+            }
+        }
+        return false;
+    }
+
     zenon* get_zenon_atomic()
     {
         zenon* zenek;
-        while (!zenek_pool_boost.pop(zenek));
+        if (try_zenon(zenek))
+            return zenek;
+        // every zenon is busy: queue on the device with the fewest waiters per zenon
+        size_t best = zenek_pools.size();
+        for (size_t n = 0; n < zenek_pools.size(); n++)
+        {
+            if (!slot_capacity[n])
+                continue;
+            if (best == zenek_pools.size() ||
+                (uint64_t)zenek_pools[n]->get_queue_depth() * slot_capacity[best] < (uint64_t)zenek_pools[best]->get_queue_depth() * slot_capacity[n])
+                best = n;
+        }
+        zenek = zenek_pools[best]->acquire();
+        router.started(best);
+        return zenek;
+    }
+
+    // a zenon of the given slot, for a payload registered with its context
+    zenon* get_zenon_atomic(size_t slot)
+    {
+        zenon* zenek = zenek_pools[slot]->acquire();
+        router.started(slot);
         return zenek;
     }
 
     void return_zenon_atomic(zenon* zenek)
     {
-        zenek_pool_boost.push(zenek);
+        router.finished(zenek->get_slot());
+        zenek_pools[zenek->get_slot()]->release(zenek);
     }
 };
 
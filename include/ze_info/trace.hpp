@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Binary arrival trace: a trace_header followed by count trace_records, all
+// little endian. Timestamps are absolute; replay schedules every query at its
+// offset from the first record.
+#pragma pack( push, 1 )
+struct trace_header
+{
+    char magic[ 4 ];
+    uint32_t version;
+    uint64_t count;
+};
+
+struct trace_record
+{
+    uint64_t timestamp_ns;
+    uint32_t payload_size;
+    uint32_t model_id;
+    // EDF tie break, higher runs first among equal deadlines
+    uint32_t priority;
+    uint32_t reserved;
+};
+#pragma pack( pop )
+
+static_assert( sizeof( trace_header ) == 16, "trace_header layout" );
+static_assert( sizeof( trace_record ) == 24, "trace_record layout" );
+
+// Read only memory mapping of a trace file, records are not copied.
+class trace_file
+{
+public:
+    static const uint32_t version = 2;
+
+    trace_file() = default;
+    trace_file( const trace_file& ) = delete;
+    trace_file& operator=( const trace_file& ) = delete;
+    ~trace_file() { close(); }
+
+    // returns false and leaves the object empty if the file is missing or malformed
+    bool open( const std::string& file_path );
+    void close();
+
+    size_t size() const { return count; }
+    const trace_record& operator[]( size_t n ) const { return records[ n ]; }
+    const trace_record* begin() const { return records; }
+    const trace_record* end() const { return records + count; }
+
+    static bool write( const std::string& file_path, const std::vector<trace_record>& records );
+
+private:
+    const trace_record* records = nullptr;
+    size_t count = 0;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* map_handle = nullptr;
+#endif
+};
+
+#endif
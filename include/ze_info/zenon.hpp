@@ -14,11 +14,18 @@
 #include <iomanip>
 #include <vector>
 #include <string>
+#include <memory>
+#include <mutex>
 #include "ze_api.h"
 #include "ze_info/offline_compiler.hpp"
 #include "ze_info/utils.hpp"
-
-#define MAX_EVENTS_COUNT 55
+#include "ze_info/device_topology.hpp"
+#include "ze_info/graph.hpp"
+#include "ze_info/graph_template.hpp"
+#include "ze_info/host_buffer_pool.hpp"
+#include "ze_info/cpu_graph.hpp"
+#include "ze_info/calibration.hpp"
+#include "ze_info/kernel_registry.hpp"
 
 struct gpu_results
 {
@@ -35,8 +42,10 @@ class zenon
 {
 public:
     zenon(std::vector<uint8_t>* in, std::vector<uint8_t>* in2, std::vector<uint8_t>* out);
-    zenon(bool log = false, bool multi_ccs = true);
-    zenon(int _id, bool multi_ccs_enable, bool _log = false) : zenon(_log, multi_ccs_enable)
+    // recording: the graph to instantiate, graph_template::get() when null
+    zenon(bool log = false, bool multi_ccs = true, size_t _slot = 0, const graph_template* recording = nullptr);
+    zenon(int _id, bool multi_ccs_enable, bool _log = false, size_t _slot = 0, const graph_template* recording = nullptr) :
+        zenon(_log, multi_ccs_enable, _slot, recording)
     {
         multi_ccs = multi_ccs_enable;
         id = _id;
@@ -44,6 +53,10 @@ public:
     }
     ~zenon();
     void create_module(const std::string& cl_file_path = "module.cl");
+    // --overlap: this zenon is the second input/output buffer set of owner, its
+    // graph runs on owner's intermediates, one of the two computes at a time.
+    // Called before allocate_buffers.
+    void share_intermediates(zenon& owner);
     void allocate_buffers();
     void set_input1(std::vector<uint8_t>& in1) { input1 = &in1; };
     void set_input2(std::vector<uint8_t>& in2) { input2 = &in2; };
@@ -55,22 +68,52 @@ public:
     std::vector<uint8_t>* get_mem_input2() { return mem_input2; };
     std::vector<uint8_t>* get_mem_output() { return mem_output; };
     void create_cmd_list();
-    void submit_kernel_to_cmd_list(ze_kernel_handle_t& _kernel, std::vector<void*> input, void* output, ze_event_handle_t output_event, std::vector<ze_event_handle_t*> input_events, uint32_t input_event_count, int number_of_threads, int input_size); 
-    void submit_kernel_to_cmd_list(ze_kernel_handle_t& _kernel, std::vector<void*> input, void* output, ze_event_handle_t output_event, std::vector<ze_event_handle_t*> input_events, uint32_t input_event_count, int counter, int number_of_threads, int input_size );
+    void submit_kernel_to_cmd_list(ze_command_list_handle_t list, const launch_record& launch, int number_of_threads, int input_size);
     gpu_results run(uint32_t id);
-    bool is_finished( uint32_t id );
+    bool is_finished();
+    bool wait_finished( uint64_t timeout_ns );
     gpu_results get_result( uint32_t id );
     void init();
     int get_id() { return id; };
     int get_ccs_id() { return ccs_id; };
+    size_t get_slot() { return slot; };
+    size_t get_intermediate_bytes() { return intermediate_bytes; };
+    // --zero_copy: upload the next queries from the caller's payload instead of
+    // the zenon's own input vectors, nullptr switches back
+    void set_payload(const host_payload* _payload) { payload = _payload; };
+    size_t get_naive_intermediate_bytes() { return naive_intermediate_bytes; };
     void set_timestamps();
+    // host time spent submitting the compute part of a query, over every zenon
+    static void print_submit_stats(std::ostream& out);
 
 private:
-    static bool ze_initalized;
     bool log;
     bool multi_ccs;
-    void* input1_buffer = nullptr, * input2_buffer = nullptr, * mem_input1_buffer = nullptr, * mem_input2_buffer = nullptr, * im_buf1 = nullptr, * im_buf2 = nullptr, * im_buf3 = nullptr, * im_buf4 = nullptr, * im_buf5 = nullptr, * im_buf6 = nullptr;
-    void* output_buffer = nullptr, * mem_output_buffer = nullptr, * mem_output_buffer2 = nullptr;
+    void* input1_buffer = nullptr, * input2_buffer = nullptr, * mem_input1_buffer = nullptr, * mem_input2_buffer = nullptr;
+    void* output_buffer = nullptr;
+    // device buffer of every graph tensor, indexed like network_graph::get_tensors()
+    std::vector<void*> tensor_buffers;
+    // holds every intermediate tensor at its planned offset
+    void* intermediate_arena = nullptr;
+    // the zenon whose intermediates this one uses, nullptr when they are its own
+    zenon* intermediates_owner = nullptr;
+    // the one of the pair whose graph may still be running on the intermediates
+    struct compute_order
+    {
+        std::mutex mtx;
+        zenon* computing = nullptr;
+    };
+    std::shared_ptr<compute_order> order;
+    void wait_for_twin();
+    const host_payload* payload = nullptr;
+    // --backend cpu: the graph runs on a TBB flow graph over host memory, the
+    // tensor buffers point into the zenon's vectors and cpu_arena
+    std::unique_ptr<cpu_graph> cpu;
+    std::vector<uint8_t> cpu_arena;
+    std::vector<size_t> tensor_bytes;
+    size_t intermediate_bytes = 0, naive_intermediate_bytes = 0;
+    const network_graph* graph = nullptr;
+    const graph_template* recorded_graph = nullptr;
     ze_host_mem_alloc_desc_t hostDesc = { ZE_STRUCTURE_TYPE_HOST_MEM_ALLOC_DESC };
     
     std::vector<uint8_t>* input1;
@@ -80,53 +123,73 @@ private:
     std::vector<uint8_t>* mem_input2;
     std::vector<uint8_t>* mem_output;
     gpu_results gpu_result;
-    int id, ccs_id;
+    int id, ccs_id = 0;
     ze_result_t result = ZE_RESULT_SUCCESS;
-    uint32_t number_of_drivers = 0;
-    static std::vector<ze_driver_handle_t> drivers;
-    static ze_driver_handle_t driver;
 
-    static uint32_t number_of_devices;
-    static std::vector<ze_device_handle_t> devices;
-    static ze_device_handle_t device;
-    static ze_context_desc_t context_descriptor;
-    static ze_context_handle_t context;
-    static uint32_t computeQueueGroupOrdinal, copyOnlyQueueGroupOrdinal;
-    ze_module_desc_t module_descriptor = {};
-    ze_module_handle_t module = nullptr;
-    ze_kernel_desc_t kernel_descriptor = {};
-    ze_kernel_handle_t kernel = nullptr;
-    ze_kernel_handle_t heavy_kernel = nullptr;
-    ze_kernel_handle_t add_buffers_kernel = nullptr;
-    ze_kernel_handle_t mul_buffers_kernel = nullptr;
-    ze_kernel_handle_t cmp_bound_kernel = nullptr;
-    ze_kernel_handle_t mem_bound_kernel = nullptr;
-    ze_kernel_handle_t set_n_to_output = nullptr;
+    // device_topology slot this zenon was placed on, the handles below are its
+    size_t slot = 0;
+    device_slot* placed = nullptr;
+    ze_device_handle_t device = nullptr;
+    ze_context_handle_t context = nullptr;
+    uint32_t computeQueueGroupOrdinal = 0, copyOnlyQueueGroupOrdinal = 0;
+    // turns cmp_bound target durations into loop counters on this device
+    counter_model cmp_bound_model;
+    // module and kernels shared with the other zenons of the context and device,
+    // with --immediate the zenon binds arguments on kernels of its own
+    kernel_set* shared_kernels = nullptr;
+    ze_kernel_handle_t own_kernels[graph_kernel_count] = {};
     
     ze_device_mem_alloc_desc_t memory_descriptor = {};
     ze_command_list_desc_t command_list_descriptor = {};
     ze_command_list_handle_t command_list = nullptr;
     ze_group_count_t group_count = {};
-    ze_command_queue_desc_t command_queue_descriptor = {};
-    ze_command_queue_handle_t command_queue;
+    // --branch_parallel: one command list per lane of the graph schedule, lane 0
+    // is command_list and holds the critical path and the completion event
+    std::vector<ze_command_list_handle_t> lane_lists;
+    std::vector<int> node_lane;
+    size_t lane_count = 1;
+    // --immediate: the graph is appended per query to immediate lists instead of
+    // executing the recorded ones, one compute list per CCS of the slot
+    ze_command_list_handle_t immediate_copy_list = nullptr;
+    std::vector<ze_command_list_handle_t> immediate_compute_lists;
+    // CCS of every lane of the current query, picked per query from the slot's shared queues
+    std::vector<ccs_queue*> active_lanes;
+    void submit_compute();
+    void finish_compute();
+    void reset_events();
+    void append_graph(const std::vector<ze_command_list_handle_t>& lists);
+    void append_input_copies(ze_command_list_handle_t list);
+    void append_output_copy(ze_command_list_handle_t list);
+    void copy_inputs();
+    void copy_output();
+    ze_command_list_handle_t create_immediate_list(uint32_t ordinal, uint32_t index, ze_command_queue_mode_t mode);
+    ze_kernel_handle_t get_kernel(graph_kernel kind);
     
     ze_command_queue_handle_t input_copy_command_queue;
-    ze_command_list_handle_t input_copy_command_list;
+    ze_command_list_handle_t input_copy_command_list = nullptr;
     ze_command_queue_desc_t input_copy_command_queue_descriptor = {};
     ze_command_list_desc_t input_copy_command_list_descriptor = {};
 
     ze_command_queue_handle_t output_copy_command_queue;
-    ze_command_list_handle_t output_copy_command_list;
+    ze_command_list_handle_t output_copy_command_list = nullptr;
     ze_command_queue_desc_t output_copy_command_queue_descriptor = {};
     ze_command_list_desc_t output_copy_command_list_descriptor = {};
 
-    static uint32_t command_queue_count, zenon_cntr;
-
     ze_event_pool_handle_t event_pool;
-    ze_event_handle_t kernel_ts_event[MAX_EVENTS_COUNT];
-    ze_kernel_timestamp_result_t kernel_ts_results[MAX_EVENTS_COUNT];
+    // one event per graph node, one for the sink barrier with several sinks and
+    // the lanes reset one last, sized by create_cmd_list
+    std::vector<ze_event_handle_t> kernel_ts_event;
+    std::vector<ze_kernel_timestamp_result_t> kernel_ts_results;
     uint32_t graph_event_count = 0;
-    std::vector<std::string> kernel_names;
+    ze_event_handle_t completion_event = nullptr;
+    ze_event_handle_t lanes_reset_event = nullptr;
+    // --overlap: signaled by the upload and the download, the host waits for the
+    // first one before the submit and for the second at the end of the query
+    ze_event_pool_handle_t copy_event_pool = nullptr;
+    ze_event_handle_t input_ready_event = nullptr;
+    ze_event_handle_t output_ready_event = nullptr;
+    // what the host waits for to know a query is done
+    ze_event_handle_t done_event() { return output_ready_event ? output_ready_event : completion_event; }
 };
 
 #endif
\ No newline at end of file
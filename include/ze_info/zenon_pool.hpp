@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#ifndef ZENON_POOL_HPP
+#define ZENON_POOL_HPP
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include "ze_info/zenon.hpp"
+#include "boost/lockfree/queue.hpp"
+
+enum class pool_wait_strategy
+{
+    spin,
+    yield,
+    park
+};
+
+bool parse_pool_wait_strategy( const std::string& name, pool_wait_strategy& strategy );
+const char* to_string( pool_wait_strategy strategy );
+
+// Pool of free zenons. acquire() takes the lock free fast path when a zenon is
+// available, otherwise waits with the selected strategy: busy spin, spin with
+// yield, or park the thread (futex on Linux) until release() hands one back.
+class zenon_pool
+{
+public:
+    zenon_pool( size_t capacity, pool_wait_strategy _strategy ) :
+        free_zenons( capacity ),
+        strategy( _strategy )
+    {
+    }
+
+    zenon* acquire();
+    bool try_acquire( zenon*& zenek );
+    void release( zenon* zenek );
+
+    uint64_t get_acquires() const { return acquires.load(); }
+    uint64_t get_contended() const { return contended.load(); }
+    uint64_t get_parks() const { return parks.load(); }
+    uint64_t get_total_wait_ns() const { return total_wait_ns.load(); }
+    uint64_t get_max_wait_ns() const { return max_wait_ns.load(); }
+    uint32_t get_queue_depth() const { return waiting.load(); }
+    uint32_t get_max_queue_depth() const { return max_waiting.load(); }
+    void print_stats( std::ostream& out ) const;
+
+private:
+    boost::lockfree::queue<zenon*> free_zenons;
+    pool_wait_strategy strategy;
+
+    std::atomic<uint32_t> release_seq{ 0 };
+    std::atomic<uint32_t> parked{ 0 };
+    std::atomic<uint32_t> waiting{ 0 };
+    std::atomic<uint32_t> max_waiting{ 0 };
+    std::atomic<uint64_t> acquires{ 0 };
+    std::atomic<uint64_t> contended{ 0 };
+    std::atomic<uint64_t> parks{ 0 };
+    std::atomic<uint64_t> total_wait_ns{ 0 };
+    std::atomic<uint64_t> max_wait_ns{ 0 };
+
+    void park( uint32_t seq );
+    void wake_one();
+};
+
+#endif
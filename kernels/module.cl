@@ -1,3 +1,21 @@
+// Built with -DSPEC_THREADS=<n> -DSPEC_INPUT_SIZE=<n> [-DSPEC_MEM_KB=<n>] the
+// sizes are compile time constants and the matching arguments are ignored.
+#ifdef SPEC_THREADS
+#define THREADS SPEC_THREADS
+#else
+#define THREADS threads
+#endif
+#ifdef SPEC_INPUT_SIZE
+#define INPUT_SIZE SPEC_INPUT_SIZE
+#else
+#define INPUT_SIZE input_size
+#endif
+#ifdef SPEC_MEM_KB
+#define MEM_KB SPEC_MEM_KB
+#else
+#define MEM_KB counter
+#endif
+
 kernel void copy_buffer(const global char *input, global char *output, int threads, int input_size)
 {
     const size_t id = get_global_id(0);
@@ -10,15 +28,16 @@ kernel void add_buffers(const global char *input, const global char *input2, glo
 	
 	const size_t id = get_group_id(0)*2 + get_sub_group_id();
     if(get_sub_group_local_id() == 0){
-        for (int j = 0; j < input_size/threads;j++){
+        const int rows = INPUT_SIZE/THREADS;
+        for (int j = 0; j < rows;j++){
             int a = 1;
-            int in1 = input[id + j*threads];
-            int in2 = input2[id + j*threads];
+            int in1 = input[id + j*THREADS];
+            int in2 = input2[id + j*THREADS];
             for (int i = 1; i <= 123 * 1; i++)
                 {
                     a += in1 + in2;
                 }
-            output[id + j*threads] = a;
+            output[id + j*THREADS] = a;
         }
     }
 }
@@ -44,15 +63,16 @@ kernel void cmp_bound_kernel(const global char *input, const global char *input2
     
     const size_t id = get_group_id(0)*2 + get_sub_group_id();
     if(get_sub_group_local_id() == 0){
-        for (int j = 0; j < input_size/threads;j++){
+        const int rows = INPUT_SIZE/THREADS;
+        for (int j = 0; j < rows;j++){
             int a = 1;
-            int in1 = input[id + j*threads];
-            int in2 = input2[id + j*threads];
+            int in1 = input[id + j*THREADS];
+            int in2 = input2[id + j*THREADS];
             for (int i = 1; i <= counter; i++)
             {
                 a += in1 + in2;
             }
-            output[id + j*threads] = a;
+            output[id + j*THREADS] = a;
         }
     }
     
@@ -65,7 +85,7 @@ kernel void mem_bound_kernel(const global char *input, const global char *input2
     uint a = 0;
     uint b = 0;
     const size_t id = get_group_id(0)*2 + get_sub_group_id();
-    int threadblock = input_size*counter/threads;
+    const int threadblock = INPUT_SIZE*MEM_KB/THREADS;
     if(get_sub_group_local_id() == 0){
         for (int i = 0; i < threadblock; i++){
             
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/calibration.hpp"
+#include "ze_info/kernel_probe.hpp"
+#include "ze_info/ze_utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+bool force_calibration = false;
+std::string calibration_path = "calibration.txt";
+
+calibration_store& calibration_store::get()
+{
+    static calibration_store instance;
+    return instance;
+}
+
+bool calibration_store::load( const std::string& path )
+{
+    std::ifstream in( path );
+    if( !in )
+        return false;
+    std::string line;
+    while( std::getline( in, line ) )
+    {
+        std::istringstream fields( line );
+        std::string key;
+        counter_model model;
+        if( line.empty() || line[ 0 ] == '#' || !( fields >> key >> model.slope >> model.intercept ) )
+            continue;
+        models[ key ] = model;
+        std::getline( fields >> std::ws, names[ key ] );
+    }
+    return true;
+}
+
+bool calibration_store::save( const std::string& path ) const
+{
+    std::ofstream out( path );
+    if( !out )
+        return false;
+    out << "# device slope intercept name, counter = slope * ns + intercept\n";
+    out << std::setprecision( 9 );
+    for( const auto& entry : models )
+    {
+        auto name = names.find( entry.first );
+        out << entry.first << " " << entry.second.slope << " " << entry.second.intercept;
+        if( name != names.end() )
+            out << " " << name->second;
+        out << "\n";
+    }
+    return true;
+}
+
+bool calibration_store::find( const std::string& key, counter_model& model ) const
+{
+    auto entry = models.find( key );
+    if( entry == models.end() )
+        return false;
+    model = entry->second;
+    return true;
+}
+
+void calibration_store::set( const std::string& key, const counter_model& model, const std::string& name )
+{
+    models[ key ] = model;
+    names[ key ] = name;
+}
+
+counter_model calibration_store::model( ze_device_handle_t device ) const
+{
+    counter_model found;
+    find( device_key( device ), found );
+    return found;
+}
+
+std::string calibration_store::device_key( ze_device_handle_t device )
+{
+    ze_device_properties_t properties = { ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES };
+    SUCCESS_OR_TERMINATE( zeDeviceGetProperties( device, &properties ) );
+    char key[ 16 ];
+    snprintf( key, sizeof( key ), "%04x:%04x", properties.vendorId, properties.deviceId );
+    return key;
+}
+
+// mean and worst relative error of the model at the targets, in percent
+static void target_error( kernel_probe& probe, const counter_model& model, const std::set<double>& targets, double& mean, double& worst, double& worst_target )
+{
+    mean = worst = worst_target = 0.0;
+    for( double target : targets )
+    {
+        double error = std::fabs( probe.measure( model.counter( target ) ) - target ) * 100.0 / target;
+        mean += error / targets.size();
+        if( error > worst )
+        {
+            worst = error;
+            worst_target = target;
+        }
+    }
+}
+
+static bool calibrate( const device_slot& slot, const graph_template& recorded, counter_model& model, std::ostream& out )
+{
+    std::set<double> targets;
+    for( const launch_record& launch : recorded.get_launches() )
+    {
+        if( launch.kernel == graph_kernel::cmp_bound && launch.target_ns > 0 )
+            targets.insert( launch.target_ns );
+    }
+    kernel_probe probe( slot, recorded.get_spirv(), "cmp_bound_kernel", true, recorded.get_threads(), recorded.get_input_size(), recorded.get_input_size() );
+
+    // counters spread geometrically over the range the targets need, twice over
+    const counter_model defaults;
+    int low = 16, high = 16384;
+    if( !targets.empty() )
+    {
+        low = std::max( 16, defaults.counter( *targets.begin() ) / 2 );
+        high = std::max( low * 8, defaults.counter( *targets.rbegin() ) * 2 );
+    }
+    const int points = 8;
+    std::vector<double> counters, durations;
+    for( int p = 0; p < points; p++ )
+    {
+        counters.push_back( std::round( low * std::pow( (double)high / low, (double)p / ( points - 1 ) ) ) );
+        durations.push_back( probe.measure( (int)counters.back() ) );
+    }
+
+    // least squares ns = a * counter + b, inverted into the counter model
+    double mean_c = 0, mean_ns = 0;
+    for( int p = 0; p < points; p++ )
+    {
+        mean_c += counters[ p ] / points;
+        mean_ns += durations[ p ] / points;
+    }
+    double cov = 0, var = 0;
+    for( int p = 0; p < points; p++ )
+    {
+        cov += ( counters[ p ] - mean_c ) * ( durations[ p ] - mean_ns );
+        var += ( counters[ p ] - mean_c ) * ( counters[ p ] - mean_c );
+    }
+    const double a = var > 0 ? cov / var : 0.0;
+    const double b = mean_ns - a * mean_c;
+    if( a <= 0 )
+    {
+        out << "  fit failed, duration does not grow with the counter, keeping the defaults\n";
+        return false;
+    }
+    model.slope = 1.0 / a;
+    model.intercept = -b / a;
+
+    double residual = 0;
+    for( int p = 0; p < points; p++ )
+    {
+        double error = ( durations[ p ] - ( a * counters[ p ] + b ) ) / durations[ p ];
+        residual += error * error / points;
+    }
+    out << "  counters " << low << " - " << high << " \t " << std::fixed << std::setprecision( 1 ) << a << " ns per iteration + " << b
+        << " ns \t fit residual: " << std::sqrt( residual ) * 100.0 << "% rms\n";
+
+    if( !targets.empty() )
+    {
+        double mean, worst, worst_target;
+        target_error( probe, defaults, targets, mean, worst, worst_target );
+        out << "  " << targets.size() << " graph targets, default constants: mean error " << mean << "% \t worst " << worst << "% at " << worst_target << " ns\n";
+        target_error( probe, model, targets, mean, worst, worst_target );
+        out << "  " << targets.size() << " graph targets, calibrated:        mean error " << mean << "% \t worst " << worst << "% at " << worst_target << " ns\n";
+    }
+    out << std::defaultfloat;
+    return true;
+}
+
+void calibrate_devices( device_topology& topology, const graph_template& recorded, std::ostream& out )
+{
+    calibration_store& store = calibration_store::get();
+    store.load( calibration_path );
+
+    // sub-devices of one device share its key and its model
+    std::set<std::string> done;
+    bool changed = false;
+    for( size_t n = 0; n < topology.size(); n++ )
+    {
+        const device_slot& slot = topology.slot( n );
+        const std::string key = calibration_store::device_key( slot.device );
+        if( !done.insert( key ).second )
+            continue;
+        counter_model model;
+        if( !force_calibration && store.find( key, model ) )
+        {
+            out << "Counter model for " << slot.name() << " (" << key << ") from " << calibration_path << ": counter = " << model.slope << " * ns + " << model.intercept << "\n";
+            continue;
+        }
+        ze_device_properties_t properties = { ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES };
+        SUCCESS_OR_TERMINATE( zeDeviceGetProperties( slot.device, &properties ) );
+        out << "Calibrating cmp_bound_kernel on " << slot.name() << " (" << key << " " << properties.name << ")\n";
+        if( calibrate( slot, recorded, model, out ) )
+        {
+            store.set( key, model, properties.name );
+            changed = true;
+            out << "  counter = " << model.slope << " * ns + " << model.intercept << "\n";
+        }
+    }
+    if( changed && !store.save( calibration_path ) )
+        out << "Could not save the counter models to " << calibration_path << "\n";
+}
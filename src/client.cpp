@@ -11,3 +11,12 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+
+std::vector<double> percentiles = { 50.0, 90.0, 99.0, 99.9 };
+std::string histogram_file;
+scenario_type scenario = scenario_type::server;
+int latency_target_us = 0;
+int samples_per_query = 8;
+int multi_stream_interval_us = 50000;
+std::string trace_path;
+std::string trace_out_path;
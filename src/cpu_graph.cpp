@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/cpu_graph.hpp"
+
+#include <chrono>
+#include <thread>
+#include "tbb/parallel_for.h"
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+cpu_graph::cpu_graph( const graph_template& recorded, const std::vector<void*>& tensors, const std::vector<size_t>& tensor_bytes ) :
+    source( flow )
+{
+    using namespace tbb::flow;
+    const std::vector<launch_record>& records = recorded.get_launches();
+    start_ns.assign( records.size(), 0 );
+    end_ns.assign( records.size(), 0 );
+    for( size_t n = 0; n < records.size(); n++ )
+    {
+        const launch_record& record = records[ n ];
+        cpu_launch launch;
+        launch.kernel = record.kernel;
+        launch.input1 = record.inputs.empty() ? nullptr : (const int8_t*)tensors[ record.inputs[ 0 ] ];
+        launch.input2 = record.inputs.size() > 1 ? (const int8_t*)tensors[ record.inputs[ 1 ] ] : launch.input1;
+        launch.output = (int8_t*)tensors[ record.output ];
+        launch.output_bytes = tensor_bytes[ record.output ];
+        launch.counter = record.counter;
+        launch.threads = recorded.get_threads();
+        launch.input_size = recorded.get_input_size();
+        launches.push_back( launch );
+
+        nodes.emplace_back( new node_type( flow, [ this, n ]( const continue_msg& ) { run_node( n ); return continue_msg(); } ) );
+        if( record.waits.empty() )
+            make_edge( source, *nodes.back() );
+        for( int wait : record.waits )
+            make_edge( *nodes[ wait ], *nodes.back() );
+    }
+    done_node.reset( new node_type( flow, [ this ]( const continue_msg& ) { done = true; return continue_msg(); } ) );
+    for( int sink : recorded.get_sinks() )
+        make_edge( *nodes[ sink ], *done_node );
+}
+
+cpu_graph::~cpu_graph()
+{
+    flow.wait_for_all();
+}
+
+void cpu_graph::run_node( size_t n )
+{
+    const cpu_launch& launch = launches[ n ];
+    start_ns[ n ] = now_ns();
+    tbb::parallel_for( tbb::blocked_range<int>( 0, cpu_work_items( launch ), cpu_work_grain( launch ) ),
+        [ &launch ]( const tbb::blocked_range<int>& range ) { run_cpu_kernel( launch, range.begin(), range.end() ); } );
+    end_ns[ n ] = now_ns();
+}
+
+void cpu_graph::start()
+{
+    done = false;
+    source.try_put( tbb::flow::continue_msg() );
+}
+
+bool cpu_graph::wait( uint64_t timeout_ns )
+{
+    const uint64_t deadline = now_ns() + timeout_ns;
+    while( !done.load() )
+    {
+        if( now_ns() >= deadline )
+            return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+void cpu_graph::finish()
+{
+    flow.wait_for_all();
+}
@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/cpu_kernels.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define CPU_KERNELS_X86 1
+#include <immintrin.h>
+#else
+#define CPU_KERNELS_X86 0
+#endif
+
+// keeps the compiler from folding the counter loop into a multiply, the loop
+// is the work being simulated
+#if defined( __GNUC__ )
+#define KEEP_LOOP( x ) asm volatile( "" : "+r"( x ) )
+#define KEEP_VEC( x ) asm volatile( "" : "+v"( x ) )
+#else
+#define KEEP_LOOP( x ) ( (void)0 )
+#define KEEP_VEC( x ) ( (void)0 )
+#endif
+
+const char* to_string( cpu_isa isa )
+{
+    switch( isa )
+    {
+    case cpu_isa::scalar:
+        return "scalar";
+    case cpu_isa::sse4:
+        return "sse4";
+    case cpu_isa::avx2:
+        return "avx2";
+    case cpu_isa::avx512:
+        return "avx512";
+    }
+    return "unknown";
+}
+
+static cpu_isa detect()
+{
+#if CPU_KERNELS_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "avx512bw" ) )
+        return cpu_isa::avx512;
+    if( __builtin_cpu_supports( "avx2" ) )
+        return cpu_isa::avx2;
+    if( __builtin_cpu_supports( "sse4.1" ) )
+        return cpu_isa::sse4;
+#endif
+    return cpu_isa::scalar;
+}
+
+cpu_isa detect_cpu_isa()
+{
+    static const cpu_isa isa = detect();
+    return isa;
+}
+
+// Scalar reference, the loops of module.cl as they are. Element e of add and
+// cmp_bound is what sub-group e % threads computes in row e / threads.
+
+static void add_element( const cpu_launch& l, int e, int counter )
+{
+    int a = 1;
+    int in1 = l.input1[ e ];
+    int in2 = l.input2[ e ];
+    for( int i = 1; i <= counter; i++ )
+    {
+        a += in1 + in2;
+        KEEP_LOOP( a );
+    }
+    l.output[ e ] = (int8_t)a;
+}
+
+static int mem_bound_block( const cpu_launch& l )
+{
+    return l.input_size * l.counter / l.threads;
+}
+
+// a and b only matter modulo 256, which is also how the vector versions get away
+// with byte lanes: one running sum of in1 + in2
+static void mem_bound_tail( const cpu_launch& l, int id, int from, uint8_t carry )
+{
+    const int threadblock = mem_bound_block( l );
+    unsigned a = carry;
+    unsigned b = 0;
+    for( int i = from; i < threadblock; i++ )
+    {
+        int in1 = l.input1[ i + id * threadblock ];
+        int in2 = l.input2[ i + id * threadblock ];
+        a += in1;
+        b += in2;
+        l.output[ i + id * threadblock ] = (int8_t)( a + b );
+    }
+}
+
+#if CPU_KERNELS_X86
+
+// The counter loop adds in1 + in2 counter times to 1 and keeps the low byte, so
+// byte lanes with wrap around give the same bits as the scalar int.
+
+__attribute__( ( target( "sse4.1" ) ) )
+static void add_range_sse4( const cpu_launch& l, int first, int last, int counter )
+{
+    int e = first;
+    for( ; e + 16 <= last; e += 16 )
+    {
+        __m128i s = _mm_add_epi8( _mm_loadu_si128( (const __m128i*)( l.input1 + e ) ), _mm_loadu_si128( (const __m128i*)( l.input2 + e ) ) );
+        __m128i a = _mm_set1_epi8( 1 );
+        for( int i = 1; i <= counter; i++ )
+        {
+            a = _mm_add_epi8( a, s );
+            KEEP_VEC( a );
+        }
+        _mm_storeu_si128( (__m128i*)( l.output + e ), a );
+    }
+    for( ; e < last; e++ )
+        add_element( l, e, counter );
+}
+
+__attribute__( ( target( "avx2" ) ) )
+static void add_range_avx2( const cpu_launch& l, int first, int last, int counter )
+{
+    int e = first;
+    for( ; e + 32 <= last; e += 32 )
+    {
+        __m256i s = _mm256_add_epi8( _mm256_loadu_si256( (const __m256i*)( l.input1 + e ) ), _mm256_loadu_si256( (const __m256i*)( l.input2 + e ) ) );
+        __m256i a = _mm256_set1_epi8( 1 );
+        for( int i = 1; i <= counter; i++ )
+        {
+            a = _mm256_add_epi8( a, s );
+            KEEP_VEC( a );
+        }
+        _mm256_storeu_si256( (__m256i*)( l.output + e ), a );
+    }
+    for( ; e < last; e++ )
+        add_element( l, e, counter );
+}
+
+__attribute__( ( target( "avx512f,avx512bw" ) ) )
+static void add_range_avx512( const cpu_launch& l, int first, int last, int counter )
+{
+    int e = first;
+    for( ; e + 64 <= last; e += 64 )
+    {
+        __m512i s = _mm512_add_epi8( _mm512_loadu_si512( l.input1 + e ), _mm512_loadu_si512( l.input2 + e ) );
+        __m512i a = _mm512_set1_epi8( 1 );
+        for( int i = 1; i <= counter; i++ )
+        {
+            a = _mm512_add_epi8( a, s );
+            KEEP_VEC( a );
+        }
+        _mm512_storeu_si512( l.output + e, a );
+    }
+    for( ; e < last; e++ )
+        add_element( l, e, counter );
+}
+
+// mem_bound: prefix sum of in1 + in2 along the block, in log steps inside each
+// 128 bit lane, then the lanes' totals carried across
+
+__attribute__( ( target( "sse4.1" ) ) )
+static void mem_bound_sse4( const cpu_launch& l, int id )
+{
+    const int threadblock = mem_bound_block( l );
+    const size_t base = (size_t)id * threadblock;
+    __m128i carry = _mm_setzero_si128();
+    int i = 0;
+    for( ; i + 16 <= threadblock; i += 16 )
+    {
+        __m128i v = _mm_add_epi8( _mm_loadu_si128( (const __m128i*)( l.input1 + base + i ) ), _mm_loadu_si128( (const __m128i*)( l.input2 + base + i ) ) );
+        v = _mm_add_epi8( v, _mm_slli_si128( v, 1 ) );
+        v = _mm_add_epi8( v, _mm_slli_si128( v, 2 ) );
+        v = _mm_add_epi8( v, _mm_slli_si128( v, 4 ) );
+        v = _mm_add_epi8( v, _mm_slli_si128( v, 8 ) );
+        v = _mm_add_epi8( v, carry );
+        _mm_storeu_si128( (__m128i*)( l.output + base + i ), v );
+        carry = _mm_shuffle_epi8( v, _mm_set1_epi8( 15 ) );
+    }
+    mem_bound_tail( l, id, i, (uint8_t)_mm_extract_epi8( carry, 0 ) );
+}
+
+__attribute__( ( target( "avx2" ) ) )
+static void mem_bound_avx2( const cpu_launch& l, int id )
+{
+    const int threadblock = mem_bound_block( l );
+    const size_t base = (size_t)id * threadblock;
+    uint8_t carry = 0;
+    int i = 0;
+    for( ; i + 32 <= threadblock; i += 32 )
+    {
+        __m256i v = _mm256_add_epi8( _mm256_loadu_si256( (const __m256i*)( l.input1 + base + i ) ), _mm256_loadu_si256( (const __m256i*)( l.input2 + base + i ) ) );
+        v = _mm256_add_epi8( v, _mm256_slli_si256( v, 1 ) );
+        v = _mm256_add_epi8( v, _mm256_slli_si256( v, 2 ) );
+        v = _mm256_add_epi8( v, _mm256_slli_si256( v, 4 ) );
+        v = _mm256_add_epi8( v, _mm256_slli_si256( v, 8 ) );
+        // low lane total into the high lane
+        __m256i totals = _mm256_shuffle_epi8( v, _mm256_set1_epi8( 15 ) );
+        v = _mm256_add_epi8( v, _mm256_permute2x128_si256( totals, totals, 0x08 ) );
+        v = _mm256_add_epi8( v, _mm256_set1_epi8( (char)carry ) );
+        _mm256_storeu_si256( (__m256i*)( l.output + base + i ), v );
+        carry = (uint8_t)_mm256_extract_epi8( v, 31 );
+    }
+    mem_bound_tail( l, id, i, carry );
+}
+
+__attribute__( ( target( "avx512f,avx512bw" ) ) )
+static void mem_bound_avx512( const cpu_launch& l, int id )
+{
+    const int threadblock = mem_bound_block( l );
+    const size_t base = (size_t)id * threadblock;
+    uint8_t carry = 0;
+    int i = 0;
+    for( ; i + 64 <= threadblock; i += 64 )
+    {
+        __m512i v = _mm512_add_epi8( _mm512_loadu_si512( l.input1 + base + i ), _mm512_loadu_si512( l.input2 + base + i ) );
+        v = _mm512_add_epi8( v, _mm512_bslli_epi128( v, 1 ) );
+        v = _mm512_add_epi8( v, _mm512_bslli_epi128( v, 2 ) );
+        v = _mm512_add_epi8( v, _mm512_bslli_epi128( v, 4 ) );
+        v = _mm512_add_epi8( v, _mm512_bslli_epi128( v, 8 ) );
+        // every lane gets the totals of the lanes below it
+        __m512i totals = _mm512_shuffle_epi8( v, _mm512_set1_epi8( 15 ) );
+        __m512i below = _mm512_maskz_shuffle_i64x2( 0xFC, totals, totals, _MM_SHUFFLE( 2, 1, 0, 0 ) );
+        below = _mm512_add_epi8( below, _mm512_maskz_shuffle_i64x2( 0xF0, totals, totals, _MM_SHUFFLE( 1, 0, 0, 0 ) ) );
+        below = _mm512_add_epi8( below, _mm512_maskz_shuffle_i64x2( 0xC0, totals, totals, _MM_SHUFFLE( 0, 0, 0, 0 ) ) );
+        v = _mm512_add_epi8( v, below );
+        v = _mm512_add_epi8( v, _mm512_set1_epi8( (char)carry ) );
+        _mm512_storeu_si512( l.output + base + i, v );
+        carry = (uint8_t)_mm_extract_epi8( _mm512_extracti32x4_epi32( v, 3 ), 15 );
+    }
+    mem_bound_tail( l, id, i, carry );
+}
+
+#endif
+
+static void add_range( const cpu_launch& l, int first, int last, int counter, cpu_isa isa )
+{
+    switch( isa )
+    {
+#if CPU_KERNELS_X86
+    case cpu_isa::sse4:
+        add_range_sse4( l, first, last, counter );
+        return;
+    case cpu_isa::avx2:
+        add_range_avx2( l, first, last, counter );
+        return;
+    case cpu_isa::avx512:
+        add_range_avx512( l, first, last, counter );
+        return;
+#endif
+    default:
+        for( int e = first; e < last; e++ )
+            add_element( l, e, counter );
+    }
+}
+
+static void mem_bound( const cpu_launch& l, int id, cpu_isa isa )
+{
+    switch( isa )
+    {
+#if CPU_KERNELS_X86
+    case cpu_isa::sse4:
+        mem_bound_sse4( l, id );
+        return;
+    case cpu_isa::avx2:
+        mem_bound_avx2( l, id );
+        return;
+    case cpu_isa::avx512:
+        mem_bound_avx512( l, id );
+        return;
+#endif
+    default:
+        mem_bound_tail( l, id, 0, 0 );
+    }
+}
+
+void run_cpu_kernel( const cpu_launch& launch, int first_id, int last_id, cpu_isa isa )
+{
+    switch( launch.kernel )
+    {
+    case graph_kernel::add:
+        add_range( launch, first_id, last_id, 123, isa );
+        break;
+    case graph_kernel::cmp_bound:
+        add_range( launch, first_id, last_id, launch.counter, isa );
+        break;
+    case graph_kernel::mem_bound:
+        for( int id = first_id; id < last_id; id++ )
+            mem_bound( launch, id, isa );
+        break;
+    case graph_kernel::copy:
+        if( isa == cpu_isa::scalar )
+        {
+            for( int id = first_id; id < last_id; id++ )
+                launch.output[ id ] = launch.input1[ id ];
+        }
+        else
+            memcpy( launch.output + first_id, launch.input1 + first_id, last_id - first_id );
+        break;
+    case graph_kernel::set_n:
+        if( isa == cpu_isa::scalar )
+        {
+            for( int id = first_id; id < last_id; id++ )
+                launch.output[ id ] = (int8_t)launch.counter;
+        }
+        else
+            memset( launch.output + first_id, launch.counter, last_id - first_id );
+        break;
+    }
+}
+
+void run_cpu_kernel( const cpu_launch& launch, int first_id, int last_id )
+{
+    run_cpu_kernel( launch, first_id, last_id, detect_cpu_isa() );
+}
+
+int cpu_work_items( const cpu_launch& launch )
+{
+    switch( launch.kernel )
+    {
+    case graph_kernel::add:
+    case graph_kernel::cmp_bound:
+        // input_size / threads rows of threads bytes
+        return launch.input_size / launch.threads * launch.threads;
+    case graph_kernel::copy:
+    case graph_kernel::set_n:
+        // the GPU launches threads / 2 groups of 32
+        return (int)std::min<size_t>( launch.output_bytes, (size_t)launch.threads * 16 );
+    default:
+        return launch.threads;
+    }
+}
+
+int cpu_work_grain( const cpu_launch& launch )
+{
+    // a few cache lines per task keeps the vector loops off their scalar tails
+    return launch.kernel == graph_kernel::mem_bound ? 1 : 256;
+}
+
+bool bench_cpu_kernels( std::ostream& out, int threads, int input_size, int mem_kb )
+{
+    using namespace std::chrono;
+    const size_t mem_bytes = (size_t)input_size * mem_kb;
+    std::vector<int8_t> input1( mem_bytes ), input2( mem_bytes ), expected( mem_bytes ), result( mem_bytes );
+    std::mt19937 rng( 7 );
+    for( size_t i = 0; i < mem_bytes; i++ )
+    {
+        input1[ i ] = (int8_t)rng();
+        input2[ i ] = (int8_t)rng();
+    }
+
+    struct bench_case
+    {
+        const char* name;
+        graph_kernel kernel;
+        int counter;
+        size_t bytes;
+    };
+    const bench_case cases[] = {
+        { "add_buffers", graph_kernel::add, 123, (size_t)input_size },
+        { "cmp_bound_kernel", graph_kernel::cmp_bound, 1000, (size_t)input_size },
+        { "mem_bound_kernel", graph_kernel::mem_bound, mem_kb, mem_bytes },
+        { "copy_buffer", graph_kernel::copy, 0, mem_bytes },
+        { "set_n_to_output", graph_kernel::set_n, 7, mem_bytes },
+    };
+
+    out << "CPU kernels, single thread, threads: " << threads << " input_size: " << input_size << " mem: " << mem_kb
+        << " kB, best ISA: " << to_string( detect_cpu_isa() ) << "\n";
+    bool all_match = true;
+    for( const bench_case& c : cases )
+    {
+        cpu_launch launch;
+        launch.kernel = c.kernel;
+        launch.input1 = input1.data();
+        launch.input2 = input2.data();
+        launch.output = result.data();
+        launch.output_bytes = c.bytes;
+        launch.counter = c.counter;
+        launch.threads = threads;
+        launch.input_size = input_size;
+        const int items = ( c.kernel == graph_kernel::copy || c.kernel == graph_kernel::set_n ) ? (int)c.bytes : cpu_work_items( launch );
+
+        // bytes read and written, and kernel loop iterations, per run
+        double traffic = 0, ops = 0;
+        switch( c.kernel )
+        {
+        case graph_kernel::add:
+        case graph_kernel::cmp_bound:
+            traffic = 3.0 * items;
+            ops = (double)items * std::max( 0, c.counter );
+            break;
+        case graph_kernel::mem_bound:
+            traffic = 3.0 * mem_bound_block( launch ) * items;
+            ops = (double)mem_bound_block( launch ) * items;
+            break;
+        case graph_kernel::copy:
+            traffic = 2.0 * items;
+            ops = items;
+            break;
+        case graph_kernel::set_n:
+            traffic = items;
+            ops = items;
+            break;
+        }
+
+        std::fill( expected.begin(), expected.end(), 0 );
+        launch.output = expected.data();
+        run_cpu_kernel( launch, 0, items, cpu_isa::scalar );
+        launch.output = result.data();
+
+        for( int level = (int)cpu_isa::scalar; level <= (int)detect_cpu_isa(); level++ )
+        {
+            const cpu_isa isa = (cpu_isa)level;
+            std::fill( result.begin(), result.end(), 0 );
+            run_cpu_kernel( launch, 0, items, isa );
+            const bool match = result == expected;
+            all_match = all_match && match;
+
+            int runs = 0;
+            auto start = high_resolution_clock::now();
+            double seconds = 0;
+            while( runs < 3 || seconds < 0.05 )
+            {
+                run_cpu_kernel( launch, 0, items, isa );
+                runs++;
+                seconds = duration<double>( high_resolution_clock::now() - start ).count();
+            }
+            out << "  " << std::left << std::setw( 18 ) << c.name << std::setw( 8 ) << to_string( isa ) << std::right << std::fixed << std::setprecision( 2 )
+                << " \t " << traffic * runs / seconds / 1e9 << " GB/s"
+                << " \t " << ops * runs / seconds / 1e9 << " Gops/s"
+                << " \t " << ( match ? "matches scalar" : "MISMATCH" ) << "\n";
+        }
+    }
+    return all_match;
+}
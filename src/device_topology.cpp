@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/device_topology.hpp"
+#include "ze_info/ze_utils.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+
+std::string device_slot::name() const
+{
+    std::string n = "device " + std::to_string( device_index );
+    if( sub_device_index >= 0 )
+        n += "." + std::to_string( sub_device_index );
+    return n;
+}
+
+ccs_queue& device_slot::acquire_ccs( bool multi_ccs )
+{
+    ccs_queue* best = ccs[ 0 ].get();
+    if( multi_ccs )
+    {
+        for( auto& engine : ccs )
+        {
+            if( engine->inflight.load() < best->inflight.load() )
+                best = engine.get();
+        }
+    }
+    mark_busy( *best );
+    return *best;
+}
+
+std::vector<ccs_queue*> device_slot::acquire_ccs_group( size_t count, bool multi_ccs )
+{
+    std::vector<ccs_queue*> group{ &acquire_ccs( multi_ccs ) };
+    for( size_t k = 1; k < count && k < ccs.size(); k++ )
+    {
+        ccs_queue* engine = ccs[ ( group[ 0 ]->index + k ) % ccs.size() ].get();
+        mark_busy( *engine );
+        group.push_back( engine );
+    }
+    return group;
+}
+
+void device_slot::mark_busy( ccs_queue& engine )
+{
+    std::lock_guard<std::mutex> lock( engine.mtx );
+    if( engine.inflight++ == 0 )
+        engine.busy_since = std::chrono::high_resolution_clock::now();
+    engine.submitted++;
+}
+
+void device_slot::release_ccs( ccs_queue& engine )
+{
+    std::lock_guard<std::mutex> lock( engine.mtx );
+    if( --engine.inflight == 0 )
+        engine.busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::high_resolution_clock::now() - engine.busy_since ).count();
+}
+
+void device_slot::print_ccs_stats( std::ostream& out, double wall_ms ) const
+{
+    for( auto& engine : ccs )
+    {
+        out << "  " << name() << " ccs " << engine->index << ": queries: " << engine->submitted.load()
+            << " \t busy: " << std::fixed << std::setprecision( 1 ) << ( wall_ms > 0 ? engine->busy_ns / 1e4 / wall_ms : 0.0 ) << "%\n";
+    }
+}
+
+device_topology& device_topology::get()
+{
+    static device_topology topology;
+    return topology;
+}
+
+void device_topology::enumerate( bool log )
+{
+    if( is_enumerated() )
+        return;
+    SUCCESS_OR_TERMINATE( zeInit( ZE_INIT_FLAG_GPU_ONLY ) );
+    uint32_t number_of_drivers = 0;
+    SUCCESS_OR_TERMINATE( zeDriverGet( &number_of_drivers, nullptr ) );
+    std::vector<ze_driver_handle_t> drivers( number_of_drivers );
+    SUCCESS_OR_TERMINATE( zeDriverGet( &number_of_drivers, drivers.data() ) );
+    if( log )
+        std::cout << "Number of drivers: " << number_of_drivers << std::endl;
+    ze_driver_handle_t driver = drivers[ 0 ];
+
+    uint32_t number_of_devices = 0;
+    SUCCESS_OR_TERMINATE( zeDeviceGet( driver, &number_of_devices, nullptr ) );
+    std::vector<ze_device_handle_t> devices( number_of_devices );
+    SUCCESS_OR_TERMINATE( zeDeviceGet( driver, &number_of_devices, devices.data() ) );
+    if( log )
+        std::cout << "number of devices: " << number_of_devices << std::endl;
+
+    // integrated GPUs are only used when there is no discrete one
+    std::vector<ze_device_handle_t> discrete, integrated;
+    for( auto device : devices )
+    {
+        ze_device_properties_t device_properties = { ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES };
+        SUCCESS_OR_TERMINATE( zeDeviceGetProperties( device, &device_properties ) );
+        if( ZE_DEVICE_TYPE_GPU != device_properties.type )
+            continue;
+        if( log )
+            std::cout << "GPU device found:" << std::hex << device_properties.deviceId << std::dec << std::endl;
+        if( device_properties.flags & ZE_DEVICE_PROPERTY_FLAG_INTEGRATED )
+            integrated.push_back( device );
+        else
+            discrete.push_back( device );
+    }
+    std::vector<ze_device_handle_t>& used = discrete.empty() ? integrated : discrete;
+    if( used.empty() )
+    {
+        std::cout << "No GPU device found" << std::endl;
+        std::terminate();
+    }
+
+    for( size_t d = 0; d < used.size(); d++ )
+    {
+        ze_context_desc_t context_descriptor = { ZE_STRUCTURE_TYPE_CONTEXT_DESC };
+        ze_context_handle_t context = nullptr;
+        SUCCESS_OR_TERMINATE( zeContextCreate( driver, &context_descriptor, &context ) );
+        contexts.push_back( context );
+
+        uint32_t sub_device_count = 0;
+        SUCCESS_OR_TERMINATE( zeDeviceGetSubDevices( used[ d ], &sub_device_count, nullptr ) );
+        std::vector<ze_device_handle_t> sub_devices( sub_device_count );
+        if( sub_device_count )
+            SUCCESS_OR_TERMINATE( zeDeviceGetSubDevices( used[ d ], &sub_device_count, sub_devices.data() ) );
+        add_device( (int)d, used[ d ], context, sub_devices );
+    }
+    build_placement();
+
+    if( log )
+    {
+        for( auto& s : slots )
+            std::cout << s->name() << ": compute queues: " << s->compute_queue_count << std::endl;
+    }
+}
+
+void device_topology::add_device( int device_index, ze_device_handle_t device, ze_context_handle_t context, const std::vector<ze_device_handle_t>& sub_devices )
+{
+    std::vector<ze_device_handle_t> leaves = sub_devices;
+    if( leaves.empty() )
+        leaves.push_back( device );
+    for( size_t s = 0; s < leaves.size(); s++ )
+    {
+        slots.emplace_back( new device_slot( device_index, sub_devices.empty() ? -1 : (int)s ) );
+        device_slot& slot = *slots.back();
+        slot.device = leaves[ s ];
+        slot.context = context;
+
+        // Discover all command queue groups
+        uint32_t group_count = 0;
+        zeDeviceGetCommandQueueGroupProperties( slot.device, &group_count, nullptr );
+        std::vector<ze_command_queue_group_properties_t> groups( group_count, { ZE_STRUCTURE_TYPE_COMMAND_QUEUE_GROUP_PROPERTIES } );
+        zeDeviceGetCommandQueueGroupProperties( slot.device, &group_count, groups.data() );
+
+        // Find a command queue type that support compute
+        slot.compute_ordinal = group_count;
+        for( uint32_t i = 0; i < group_count; ++i )
+        {
+            if( groups[ i ].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COMPUTE )
+                slot.compute_ordinal = i;
+
+            if( !( groups[ i ].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COMPUTE ) &&
+                ( groups[ i ].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COPY ) )
+            {
+                slot.copy_ordinal = i;
+                break;
+            }
+        }
+        if( slot.compute_ordinal < group_count )
+            slot.compute_queue_count = std::max( 1u, groups[ slot.compute_ordinal ].numQueues );
+        create_ccs_queues( slot );
+    }
+}
+
+void device_topology::create_ccs_queues( device_slot& slot )
+{
+    for( uint32_t i = 0; i < slot.compute_queue_count; i++ )
+    {
+        slot.ccs.emplace_back( new ccs_queue );
+        slot.ccs.back()->index = i;
+        if( fake )
+            continue;
+        ze_command_queue_desc_t command_queue_descriptor = { ZE_STRUCTURE_TYPE_COMMAND_QUEUE_DESC };
+        command_queue_descriptor.ordinal = slot.compute_ordinal;
+        command_queue_descriptor.index = i;
+        command_queue_descriptor.mode = ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS;
+        command_queue_descriptor.priority = ZE_COMMAND_QUEUE_PRIORITY_NORMAL;
+        SUCCESS_OR_TERMINATE( zeCommandQueueCreate( slot.context, slot.device, &command_queue_descriptor, &slot.ccs.back()->queue ) );
+    }
+}
+
+void device_topology::enumerate_fake( int devices, int sub_devices, uint32_t queues_per_slot )
+{
+    release();
+    fake = true;
+    for( int d = 0; d < devices; d++ )
+    {
+        contexts.push_back( nullptr );
+        for( int s = 0; s < std::max( 1, sub_devices ); s++ )
+        {
+            slots.emplace_back( new device_slot( d, sub_devices > 0 ? s : -1 ) );
+            slots.back()->compute_queue_count = queues_per_slot;
+            create_ccs_queues( *slots.back() );
+        }
+    }
+    build_placement();
+}
+
+void device_topology::build_placement()
+{
+    placement.clear();
+    for( int sub = -1;; sub++ )
+    {
+        size_t added = 0;
+        for( size_t n = 0; n < slots.size(); n++ )
+        {
+            if( slots[ n ]->sub_device_index == sub )
+            {
+                placement.push_back( n );
+                added++;
+            }
+        }
+        if( !added && sub >= 0 )
+            break;
+    }
+}
+
+void device_topology::release()
+{
+    if( !fake )
+    {
+        for( auto& s : slots )
+        {
+            for( auto& engine : s->ccs )
+                SUCCESS_OR_TERMINATE( zeCommandQueueDestroy( engine->queue ) );
+        }
+        for( auto context : contexts )
+            SUCCESS_OR_TERMINATE( zeContextDestroy( context ) );
+    }
+    contexts.clear();
+    slots.clear();
+    placement.clear();
+    fake = false;
+}
+
+std::vector<size_t> device_router::order() const
+{
+    std::vector<size_t> slots( inflight.size() );
+    for( size_t n = 0; n < slots.size(); n++ )
+        slots[ n ] = n;
+    std::stable_sort( slots.begin(), slots.end(), [ this ]( size_t a, size_t b ) { return inflight[ a ].load() < inflight[ b ].load(); } );
+    return slots;
+}
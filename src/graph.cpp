@@ -0,0 +1,541 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/graph.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <algorithm>
+
+extern bool resnet, disable_blitter;
+std::string graph_file;
+bool fuse_kernels = false;
+extern short memory_used_by_mem_bound_kernel;
+
+// ResNet-50 timings measured per layer, conv1 to res5c
+static const char* resnet50_graph = R"(
+node conv1            mem_bound 187717 mem_in1,mem_in2 -> mem_a
+node pool1            mem_bound 145798 mem_in1,mem_in2 -> mem_b after conv1
+node res2a_branch1    mem_bound 201456 mem_in1,mem_in2 -> mem_a after pool1
+node res2a_branch2a   mem_bound  67940 mem_in1,mem_in2 -> mem_b after pool1
+node res2a_branch2b   cmp_bound  56114 in1,in2 -> im5 after res2a_branch2a
+node res2a_branch2c   mem_bound 356590 mem_in1,mem_in2 -> mem_b after res2a_branch2b
+node res2b_branch2a   mem_bound 200166 mem_in1,mem_in2 -> mem_b after res2a_branch1,res2a_branch2c
+node res2b_branch2b   cmp_bound  56114 in1,in2 -> im2 after res2b_branch2a
+node res2b_branch2c   mem_bound 356590 mem_in1,mem_in2 -> mem_a after res2b_branch2b
+node res2c_branch2a   mem_bound 200166 mem_in1,mem_in2 -> mem_b after res2b_branch2c
+node res2c_branch2b   cmp_bound  56114 in1,in2 -> im5 after res2c_branch2a
+node res2c_branch2c   mem_bound 356590 mem_in1,mem_in2 -> mem_a after res2c_branch2b
+node res3a_branch1    mem_bound 183438 mem_in1,mem_in2 -> mem_a after res2c_branch2c
+node res3a_branch2a   mem_bound  56519 mem_in1,mem_in2 -> mem_a after res2c_branch2c
+node res3a_branch2b   cmp_bound  55891 in1,in2 -> im3 after res3a_branch2a
+node res3a_branch2c   mem_bound 149931 mem_in1,mem_in2 -> mem_b after res3a_branch2b
+node res3b_branch2a   mem_bound  71228 mem_in1,mem_in2 -> mem_a after res3a_branch1,res3a_branch2c
+node res3b_branch2b   cmp_bound  55891 in1,in2 -> im6 after res3b_branch2a
+node res3b_branch2c   mem_bound 138323 mem_in1,mem_in2 -> mem_a after res3b_branch2b
+node res3c_branch2a   mem_bound  71228 mem_in1,mem_in2 -> mem_b after res3b_branch2c
+node res3c_branch2b   cmp_bound  55891 in1,in2 -> im3 after res3c_branch2a
+node res3c_branch2c   mem_bound 138323 mem_in1,mem_in2 -> mem_a after res3c_branch2b
+node res3d_branch2a   mem_bound  71228 mem_in1,mem_in2 -> mem_b after res3c_branch2c
+node res3d_branch2b   cmp_bound  55891 in1,in2 -> im6 after res3d_branch2a
+node res3d_branch2c   mem_bound 138323 mem_in1,mem_in2 -> mem_a after res3d_branch2b
+node res4a_branch1    mem_bound  84758 mem_in1,mem_in2 -> mem_a after res3d_branch2c
+node res4a_branch2a   mem_bound  27988 mem_in1,mem_in2 -> mem_a after res3d_branch2c
+node res4a_branch2b   cmp_bound  55420 in1,in2 -> im4 after res4a_branch2a
+node res4a_branch2c   mem_bound  60486 mem_in1,mem_in2 -> mem_b after res4a_branch2b
+node res4b_branch2a   cmp_bound  26866 in1,in2 -> im6 after res4a_branch1,res4a_branch2c
+node res4b_branch2b   cmp_bound  55420 in1,in2 -> im1 after res4b_branch2a
+node res4b_branch2c   cmp_bound  27559 in1,in2 -> im2 after res4b_branch2b
+node res4c_branch2a   cmp_bound  26866 in1,in2 -> im3 after res4b_branch2c
+node res4c_branch2b   cmp_bound  55420 in1,in2 -> im4 after res4c_branch2a
+node res4c_branch2c   cmp_bound  27559 in1,in2 -> im4 after res4c_branch2b
+node res4d_branch2a   cmp_bound  26866 in1,in2 -> im6 after res4c_branch2c
+node res4d_branch2b   cmp_bound  55420 in1,in2 -> im1 after res4d_branch2a
+node res4d_branch2c   cmp_bound  27559 in1,in2 -> im2 after res4d_branch2b
+node res4e_branch2a   cmp_bound  26866 in1,in2 -> im3 after res4d_branch2c
+node res4e_branch2b   cmp_bound  55420 in1,in2 -> im4 after res4e_branch2a
+node res4e_branch2c   cmp_bound  27559 in1,in2 -> im4 after res4e_branch2b
+node res4f_branch2a   cmp_bound  26866 in1,in2 -> im6 after res4e_branch2c
+node res4f_branch2b   cmp_bound  55420 in1,in2 -> im1 after res4f_branch2a
+node res4f_branch2c   cmp_bound  27559 in1,in2 -> im2 after res4f_branch2b
+node res5a_branch1    cmp_bound  50121 in1,in2 -> im3 after res4f_branch2c
+node res5a_branch2a   cmp_bound  16507 in1,in2 -> im4 after res4f_branch2c
+node res5a_branch2b   cmp_bound  55398 in1,in2 -> im4 after res5a_branch2a
+node res5a_branch2c   cmp_bound  27278 in1,in2 -> im6 after res5a_branch2b
+node res5b_branch2a   cmp_bound  29580 in1,in2 -> im1 after res5a_branch1,res5a_branch2c
+node res5b_branch2b   cmp_bound  55398 in1,in2 -> im2 after res5b_branch2a
+node res5b_branch2c   cmp_bound  27278 in1,in2 -> im3 after res5b_branch2b
+node res5c_branch2a   cmp_bound  29580 in1,in2 -> im4 after res5b_branch2c
+node res5c_branch2b   cmp_bound  55398 in1,in2 -> im4 after res5c_branch2a
+node res5c_branch2c   cmp_bound  27278 in1,in2 -> out after res5c_branch2b
+)";
+
+static bool parse_kernel( const std::string& text, graph_kernel& kernel )
+{
+    if( text == "cmp_bound" )
+        kernel = graph_kernel::cmp_bound;
+    else if( text == "mem_bound" )
+        kernel = graph_kernel::mem_bound;
+    else if( text == "add" )
+        kernel = graph_kernel::add;
+    else if( text == "copy" )
+        kernel = graph_kernel::copy;
+    else if( text == "set_n" )
+        kernel = graph_kernel::set_n;
+    else
+        return false;
+    return true;
+}
+
+static std::vector<std::string> split_list( const std::string& text )
+{
+    std::vector<std::string> items;
+    std::stringstream ss( text );
+    std::string item;
+    while( std::getline( ss, item, ',' ) )
+    {
+        if( !item.empty() )
+            items.push_back( item );
+    }
+    return items;
+}
+
+int network_graph::find_tensor( const std::string& tensor_name ) const
+{
+    for( size_t t = 0; t < tensors.size(); t++ )
+    {
+        if( tensors[ t ].name == tensor_name )
+            return (int)t;
+    }
+    return -1;
+}
+
+int network_graph::tensor( const std::string& tensor_name )
+{
+    int t = find_tensor( tensor_name );
+    if( t >= 0 )
+        return t;
+    graph_tensor added;
+    added.name = tensor_name;
+    if( tensor_name == "in1" )
+        added.role = tensor_role::input1;
+    else if( tensor_name == "in2" )
+        added.role = tensor_role::input2;
+    else if( tensor_name == "mem_in1" )
+        added.role = tensor_role::mem_input1;
+    else if( tensor_name == "mem_in2" )
+        added.role = tensor_role::mem_input2;
+    else if( tensor_name == "out" )
+        added.role = tensor_role::output;
+    else
+        added.role = tensor_role::intermediate;
+    // the zenon's own mem inputs are sized with the multiplier already
+    added.mem_sized = added.role == tensor_role::mem_input1 || added.role == tensor_role::mem_input2;
+    tensors.push_back( added );
+    return (int)tensors.size() - 1;
+}
+
+bool network_graph::parse( std::istream& in, std::string& error )
+{
+    nodes.clear();
+    tensors.clear();
+    node_index.clear();
+    std::vector<int> last_writer;
+    std::string line;
+    int line_number = 0;
+    while( std::getline( in, line ) )
+    {
+        line_number++;
+        line = line.substr( 0, line.find( '#' ) );
+        std::stringstream ss( line );
+        std::string keyword;
+        if( !( ss >> keyword ) )
+            continue;
+        std::string where = "line " + std::to_string( line_number ) + ": ";
+        if( keyword != "node" )
+        {
+            error = where + "unknown statement " + keyword;
+            return false;
+        }
+
+        graph_node node;
+        std::string kernel, amount, inputs, arrow, output, after, deps;
+        if( !( ss >> node.name >> kernel >> amount >> inputs >> arrow >> output ) || arrow != "->" )
+        {
+            error = where + "expected: node <name> <kernel> <amount> <inputs> -> <output>";
+            return false;
+        }
+        if( node_index.count( node.name ) )
+        {
+            error = where + "node " + node.name + " defined twice";
+            return false;
+        }
+        if( !parse_kernel( kernel, node.kernel ) )
+        {
+            error = where + "unknown kernel " + kernel;
+            return false;
+        }
+        try
+        {
+            size_t used = 0;
+            uint64_t value = std::stoull( amount, &used );
+            if( amount.substr( used ) == "kB" && node.kernel == graph_kernel::mem_bound )
+                node.mem_kb = (uint32_t)value;
+            else if( used == amount.size() )
+                node.amount = value;
+            else
+                throw std::invalid_argument( amount );
+        }
+        catch( std::exception& )
+        {
+            error = where + "bad amount " + amount;
+            return false;
+        }
+
+        for( auto& input : split_list( inputs ) )
+            node.inputs.push_back( tensor( input ) );
+        size_t expected_inputs = node.kernel == graph_kernel::copy ? 1 : 2;
+        if( node.inputs.size() != expected_inputs )
+        {
+            error = where + kernel + " takes " + std::to_string( expected_inputs ) + " inputs";
+            return false;
+        }
+        node.output = tensor( output );
+        if( ss >> after )
+        {
+            if( after != "after" || !( ss >> deps ) )
+            {
+                error = where + "expected: after <node>[,<node>...]";
+                return false;
+            }
+            for( auto& dep : split_list( deps ) )
+            {
+                auto found = node_index.find( dep );
+                if( found == node_index.end() )
+                {
+                    error = where + "node " + dep + " is not defined before " + node.name;
+                    return false;
+                }
+                node.deps.push_back( found->second );
+            }
+        }
+
+        last_writer.resize( tensors.size(), -1 );
+        for( int input : node.inputs )
+        {
+            if( last_writer[ input ] >= 0 )
+                node.deps.push_back( last_writer[ input ] );
+        }
+        std::sort( node.deps.begin(), node.deps.end() );
+        node.deps.erase( std::unique( node.deps.begin(), node.deps.end() ), node.deps.end() );
+        if( node.kernel == graph_kernel::mem_bound )
+        {
+            for( int input : node.inputs )
+                tensors[ input ].mem_sized = true;
+            tensors[ node.output ].mem_sized = true;
+        }
+
+        node_index[ node.name ] = (int)nodes.size();
+        last_writer[ node.output ] = (int)nodes.size();
+        nodes.push_back( node );
+    }
+    if( nodes.empty() )
+    {
+        error = "graph has no nodes";
+        return false;
+    }
+    for( auto& t : tensors )
+    {
+        if( t.mem_sized && t.role != tensor_role::intermediate && t.role != tensor_role::mem_input1 && t.role != tensor_role::mem_input2 )
+        {
+            error = "tensor " + t.name + " is used by a mem_bound node but is not a mem input or an intermediate";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool network_graph::load( const std::string& file_path, std::string& error )
+{
+    std::ifstream in( file_path );
+    if( !in )
+    {
+        error = "cannot open " + file_path;
+        return false;
+    }
+    name = file_path;
+    return parse( in, error );
+}
+
+network_graph network_graph::resnet50()
+{
+    network_graph graph;
+    std::stringstream in( resnet50_graph );
+    std::string error;
+    graph.parse( in, error );
+    graph.name = "resnet50";
+    return graph;
+}
+
+network_graph network_graph::chain( int length )
+{
+    // every add waits for the two before it, the buffers rotate im1 -> im3 -> im2
+    static const char* rotation[ 3 ][ 3 ] = { { "im1", "im2", "im3" }, { "im3", "im2", "im1" }, { "im1", "im3", "im2" } };
+    std::stringstream text;
+    text << "node k0 add 0 in1,in2 -> im1\n";
+    text << "node k1 add 0 in1,in2 -> im2\n";
+    text << "node k2 add 0 in1,in2 -> im3\n";
+    for( int i = 1; i < length; i++ )
+    {
+        const char** buffers = rotation[ i % 3 ];
+        text << "node k" << i + 2 << " add 0 " << buffers[ 0 ] << "," << buffers[ 1 ] << " -> " << buffers[ 2 ]
+             << " after k" << i << ",k" << i + 1 << "\n";
+    }
+    text << "node output copy 0 im3 -> out after k" << length << ",k" << length + 1 << "\n";
+    network_graph graph;
+    std::string error;
+    graph.parse( text, error );
+    graph.name = "chain";
+    return graph;
+}
+
+std::vector<int> network_graph::sinks() const
+{
+    std::vector<bool> waited_for( nodes.size(), false );
+    for( auto& node : nodes )
+    {
+        for( int dep : node.deps )
+            waited_for[ dep ] = true;
+    }
+    std::vector<int> result;
+    for( size_t n = 0; n < nodes.size(); n++ )
+    {
+        if( !waited_for[ n ] )
+            result.push_back( (int)n );
+    }
+    return result;
+}
+
+uint32_t network_graph::max_mem_kb( uint32_t default_kb ) const
+{
+    uint32_t kb = default_kb;
+    for( auto& node : nodes )
+    {
+        if( node.kernel == graph_kernel::mem_bound )
+            kb = std::max( kb, node.mem_kb );
+    }
+    return kb;
+}
+
+size_t network_graph::fuse_chains()
+{
+    std::vector<int> waiting( nodes.size(), 0 );
+    for( auto& node : nodes )
+    {
+        for( int dep : node.deps )
+            waiting[ dep ]++;
+    }
+
+    std::vector<graph_node> fused;
+    std::vector<int> remap( nodes.size(), -1 );
+    for( size_t n = 0; n < nodes.size(); n++ )
+    {
+        graph_node& node = nodes[ n ];
+        if( node.kernel == graph_kernel::cmp_bound && node.deps.size() == 1 && waiting[ node.deps[ 0 ] ] == 1 &&
+            remap[ node.deps[ 0 ] ] == (int)fused.size() - 1 && fused.back().kernel == graph_kernel::cmp_bound )
+        {
+            // the previous launch is this node's only dependency, so moving this
+            // node's write up to it cannot overtake anything in between
+            graph_node& head = fused.back();
+            head.name += "+" + node.name;
+            head.amount += node.amount;
+            head.output = node.output;
+            head.fused += node.fused;
+            remap[ n ] = (int)fused.size() - 1;
+            continue;
+        }
+        graph_node copy = node;
+        copy.deps.clear();
+        for( int dep : node.deps )
+        {
+            if( std::find( copy.deps.begin(), copy.deps.end(), remap[ dep ] ) == copy.deps.end() )
+                copy.deps.push_back( remap[ dep ] );
+        }
+        remap[ n ] = (int)fused.size();
+        fused.push_back( copy );
+    }
+
+    size_t saved = nodes.size() - fused.size();
+    nodes.swap( fused );
+    node_index.clear();
+    for( size_t n = 0; n < nodes.size(); n++ )
+        node_index[ nodes[ n ].name ] = (int)n;
+    return saved;
+}
+
+size_t network_graph::unfused_size() const
+{
+    size_t count = 0;
+    for( auto& node : nodes )
+        count += node.fused;
+    return count;
+}
+
+uint64_t network_graph::node_cost( const graph_node& node )
+{
+    if( node.kernel == graph_kernel::cmp_bound || node.kernel == graph_kernel::mem_bound )
+        return node.amount;
+    return 0;
+}
+
+graph_schedule network_graph::schedule( int max_lanes ) const
+{
+    graph_schedule result;
+    const size_t count = nodes.size();
+    if( !count )
+        return result;
+
+    // longest path, nodes are stored in topological order
+    std::vector<uint64_t> path_ns( count, 0 );
+    std::vector<int> path_prev( count, -1 );
+    for( size_t n = 0; n < count; n++ )
+    {
+        for( int dep : nodes[ n ].deps )
+        {
+            if( path_prev[ n ] < 0 || path_ns[ dep ] > path_ns[ n ] )
+            {
+                path_ns[ n ] = path_ns[ dep ];
+                path_prev[ n ] = dep;
+            }
+        }
+        path_ns[ n ] += node_cost( nodes[ n ] );
+        result.serial_ns += node_cost( nodes[ n ] );
+    }
+    // the last of the longest paths, so zero cost nodes closing the graph stay on it
+    int last = 0;
+    for( size_t n = 0; n < count; n++ )
+    {
+        if( path_ns[ n ] >= path_ns[ last ] )
+            last = (int)n;
+    }
+    result.critical_ns = path_ns[ last ];
+    std::vector<bool> critical( count, false );
+    for( int n = last; n >= 0; n = path_prev[ n ] )
+    {
+        critical[ n ] = true;
+        result.critical_path.insert( result.critical_path.begin(), n );
+    }
+
+    result.lane_count = std::max( 1, max_lanes );
+    result.lane.assign( count, 0 );
+    std::vector<uint64_t> lane_free( result.lane_count, 0 );
+    std::vector<uint64_t> finish( count, 0 );
+    for( size_t n = 0; n < count; n++ )
+    {
+        uint64_t ready = 0;
+        for( int dep : nodes[ n ].deps )
+            ready = std::max( ready, finish[ dep ] );
+        int lane = 0;
+        if( !critical[ n ] && result.lane_count > 1 )
+        {
+            lane = 1;
+            for( int l = 2; l < result.lane_count; l++ )
+            {
+                if( std::max( ready, lane_free[ l ] ) < std::max( ready, lane_free[ lane ] ) )
+                    lane = l;
+            }
+        }
+        result.lane[ n ] = lane;
+        finish[ n ] = std::max( ready, lane_free[ lane ] ) + node_cost( nodes[ n ] );
+        lane_free[ lane ] = finish[ n ];
+        result.scheduled_ns = std::max( result.scheduled_ns, finish[ n ] );
+    }
+    return result;
+}
+
+void network_graph::print_schedule( std::ostream& out, int max_lanes ) const
+{
+    graph_schedule plan = schedule( max_lanes );
+    std::vector<int> per_lane( plan.lane_count, 0 );
+    for( int lane : plan.lane )
+        per_lane[ lane ]++;
+    out << "Graph schedule: critical path: " << plan.critical_path.size() << " nodes " << plan.critical_ns / 1000 << " us"
+        << " \t serial estimate: " << plan.serial_ns / 1000 << " us"
+        << " \t " << plan.lane_count << " lanes estimate: " << plan.scheduled_ns / 1000 << " us \t nodes per lane:";
+    for( int n : per_lane )
+        out << " " << n;
+    out << "\n";
+}
+
+void network_graph::prepend_input_init()
+{
+    std::vector<graph_node> init( 2 );
+    for( int i = 0; i < 2; i++ )
+    {
+        init[ i ].name = i == 0 ? "init_in1" : "init_in2";
+        init[ i ].kernel = graph_kernel::set_n;
+        init[ i ].amount = i + 1;
+        init[ i ].inputs = { tensor( "in1" ), tensor( "in2" ) };
+        init[ i ].output = init[ i ].inputs[ i ];
+    }
+    for( auto& node : nodes )
+    {
+        for( int& dep : node.deps )
+            dep += 2;
+        for( int i = 0; i < 2; i++ )
+        {
+            if( std::find( node.inputs.begin(), node.inputs.end(), init[ i ].output ) != node.inputs.end() )
+                node.deps.insert( node.deps.begin(), i );
+        }
+    }
+    // init_in2 reads in1 and in2 as well, so it waits for init_in1
+    init[ 1 ].deps.push_back( 0 );
+    nodes.insert( nodes.begin(), init.begin(), init.end() );
+    node_index.clear();
+    for( size_t n = 0; n < nodes.size(); n++ )
+        node_index[ nodes[ n ].name ] = (int)n;
+}
+
+static std::unique_ptr<network_graph> load_network_graph( bool fuse )
+{
+    std::unique_ptr<network_graph> graph( new network_graph( resnet ? network_graph::resnet50() : network_graph::chain() ) );
+    if( !graph_file.empty() )
+    {
+        std::string error;
+        if( !graph->load( graph_file, error ) )
+        {
+            std::cout << "Cannot load graph " << graph_file << ": " << error << std::endl;
+            return nullptr;
+        }
+    }
+    if( fuse )
+        graph->fuse_chains();
+    if( disable_blitter )
+        graph->prepend_input_init();
+    return graph;
+}
+
+const network_graph* get_network_graph()
+{
+    static std::unique_ptr<network_graph> graph;
+    static bool loaded = false;
+    if( !loaded )
+    {
+        loaded = true;
+        graph = load_network_graph( fuse_kernels );
+    }
+    return graph.get();
+}
+
+const network_graph* get_unfused_network_graph()
+{
+    if( !fuse_kernels )
+        return get_network_graph();
+    static std::unique_ptr<network_graph> graph = load_network_graph( false );
+    return graph.get();
+}
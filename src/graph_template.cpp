@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/graph_template.hpp"
+#include "ze_info/kernel_variants.hpp"
+#include "ze_info/calibration.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+extern float compute_bound_kernel_multiplier;
+extern short number_of_threads;
+extern short memory_used_by_mem_bound_kernel;
+extern int input_size;
+extern int max_batch_size;
+extern int branch_lanes;
+extern bool cpu_backend;
+bool specialize_kernels = true;
+
+const graph_template& graph_template::get()
+{
+    static graph_template instance( get_network_graph() );
+    return instance;
+}
+
+const graph_template& graph_template::get_unfused()
+{
+    if( !fuse_kernels )
+        return get();
+    static graph_template instance( get_unfused_network_graph() );
+    return instance;
+}
+
+graph_template::graph_template( const network_graph* _graph ) :
+    graph( _graph )
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // a batched zenon runs max_batch_size queries side by side, each on its own slice of the buffers
+    threads = number_of_threads * max_batch_size;
+    input_bytes = input_size * max_batch_size;
+
+    // the mem_bound counter shared by every mem_bound launch, -1 once two differ
+    int mem_kb = 0;
+    for( const graph_node& node : graph->get_nodes() )
+    {
+        launch_record launch;
+        launch.name = node.name;
+        launch.kernel = node.kernel;
+        launch.inputs = node.inputs;
+        launch.output = node.output;
+        launch.has_counter = true;
+        launch.counter = 0;
+        switch( node.kernel )
+        {
+        case graph_kernel::cmp_bound:
+            launch.target_ns = node.amount * compute_bound_kernel_multiplier;
+            launch.counter = counter_model().counter( launch.target_ns );
+            break;
+        case graph_kernel::mem_bound:
+            launch.counter = (int)( node.mem_kb ? node.mem_kb : memory_used_by_mem_bound_kernel );
+            mem_kb = ( mem_kb == 0 || mem_kb == launch.counter ) ? launch.counter : -1;
+            break;
+        case graph_kernel::set_n:
+            launch.counter = (int)node.amount;
+            break;
+        default:
+            launch.has_counter = false;
+            break;
+        }
+        // node events are indexed like the nodes
+        launch.waits = node.deps;
+        launches.push_back( launch );
+    }
+    sinks = graph->sinks();
+    for( int l = 1; l <= std::max( 1, branch_lanes ); l++ )
+        lanes.push_back( graph->schedule( l ).lane );
+
+    // the cpu backend runs the kernels natively, nothing to compile
+    if( !cpu_backend )
+    {
+        // the specialized module when it builds, the generic one otherwise
+        kernel_variants& variants = kernel_variants::get();
+        if( specialize_kernels )
+        {
+            build_options = kernel_variants::specialization_options( threads, input_bytes, mem_kb );
+            spirv = variants.spirv( build_options );
+        }
+        if( spirv.empty() )
+        {
+            build_options.clear();
+            spirv = variants.spirv( "" );
+        }
+    }
+    build_ms = std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - start ).count();
+}
+
+const std::vector<int>& graph_template::get_lanes( size_t lane_count ) const
+{
+    return lanes[ std::min( std::max<size_t>( lane_count, 1 ), lanes.size() ) - 1 ];
+}
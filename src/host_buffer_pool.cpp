@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/host_buffer_pool.hpp"
+#include "ze_info/ze_utils.hpp"
+
+#include <thread>
+#include <cstring>
+
+host_buffer_pool::host_buffer_pool( ze_context_handle_t _context, size_t slot, size_t count, size_t input_bytes, size_t mem_bytes ) :
+    context( _context ),
+    payloads( count ),
+    free_payloads( count )
+{
+    ze_host_mem_alloc_desc_t host_descriptor = { ZE_STRUCTURE_TYPE_HOST_MEM_ALLOC_DESC };
+    for( size_t n = 0; n < count; n++ )
+    {
+        host_payload& payload = payloads[ n ];
+        payload.input_bytes = input_bytes;
+        payload.mem_bytes = mem_bytes;
+        payload.slot = slot;
+        SUCCESS_OR_TERMINATE( zeMemAllocHost( context, &host_descriptor, input_bytes, 64, (void**)&payload.input1 ) );
+        SUCCESS_OR_TERMINATE( zeMemAllocHost( context, &host_descriptor, input_bytes, 64, (void**)&payload.input2 ) );
+        SUCCESS_OR_TERMINATE( zeMemAllocHost( context, &host_descriptor, mem_bytes, 64, (void**)&payload.mem_input1 ) );
+        SUCCESS_OR_TERMINATE( zeMemAllocHost( context, &host_descriptor, mem_bytes, 64, (void**)&payload.mem_input2 ) );
+        // touched once here, so the first query does not pay for the page faults
+        memset( payload.input1, 0, input_bytes );
+        memset( payload.input2, 0, input_bytes );
+        memset( payload.mem_input1, 0, mem_bytes );
+        memset( payload.mem_input2, 0, mem_bytes );
+        free_payloads.push( &payload );
+    }
+}
+
+host_buffer_pool::~host_buffer_pool()
+{
+    for( auto& payload : payloads )
+    {
+        zeMemFree( context, payload.input1 );
+        zeMemFree( context, payload.input2 );
+        zeMemFree( context, payload.mem_input1 );
+        zeMemFree( context, payload.mem_input2 );
+    }
+}
+
+host_payload* host_buffer_pool::acquire()
+{
+    host_payload* payload = nullptr;
+    if( free_payloads.pop( payload ) )
+        return payload;
+    waits++;
+    while( !free_payloads.pop( payload ) )
+        std::this_thread::yield();
+    return payload;
+}
+
+void host_buffer_pool::release( host_payload* payload )
+{
+    free_payloads.push( payload );
+}
+
+size_t host_buffer_pool::registered_bytes() const
+{
+    size_t bytes = 0;
+    for( auto& payload : payloads )
+        bytes += 2 * payload.input_bytes + 2 * payload.mem_bytes;
+    return bytes;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/kernel_probe.hpp"
+#include "ze_info/ze_utils.hpp"
+#include "ze_info/module_cache.hpp"
+
+#include <algorithm>
+
+kernel_probe::kernel_probe( const device_slot& slot, const std::vector<uint8_t>& spirv, const char* kernel_name, bool _has_counter,
+    int _threads, int _input_size, size_t buffer_bytes ) :
+    context( slot.context ),
+    has_counter( _has_counter ),
+    threads( _threads ),
+    input_size( _input_size )
+{
+    ze_device_handle_t device = slot.device;
+    ze_device_properties_t properties = { ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES };
+    SUCCESS_OR_TERMINATE( zeDeviceGetProperties( device, &properties ) );
+    timer_resolution = properties.timerResolution;
+
+    module = module_cache::get().create_module( context, device, spirv );
+    ze_kernel_desc_t kernel_descriptor = { ZE_STRUCTURE_TYPE_KERNEL_DESC };
+    kernel_descriptor.pKernelName = kernel_name;
+    SUCCESS_OR_TERMINATE( zeKernelCreate( module, &kernel_descriptor, &kernel ) );
+    SUCCESS_OR_TERMINATE( zeKernelSetGroupSize( kernel, 32, 1, 1 ) );
+
+    ze_device_mem_alloc_desc_t memory_descriptor = { ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC };
+    for( auto& buffer : buffers )
+        SUCCESS_OR_TERMINATE( zeMemAllocDevice( context, &memory_descriptor, buffer_bytes, 1, device, &buffer ) );
+    int arg = 0;
+    for( ; arg < 3; arg++ )
+        SUCCESS_OR_TERMINATE( zeKernelSetArgumentValue( kernel, arg, sizeof( void* ), &buffers[ arg ] ) );
+    if( has_counter )
+        arg++;
+    SUCCESS_OR_TERMINATE( zeKernelSetArgumentValue( kernel, arg++, sizeof( int ), &threads ) );
+    SUCCESS_OR_TERMINATE( zeKernelSetArgumentValue( kernel, arg++, sizeof( int ), &input_size ) );
+
+    ze_event_pool_desc_t pool_descriptor = { ZE_STRUCTURE_TYPE_EVENT_POOL_DESC };
+    pool_descriptor.count = 1;
+    pool_descriptor.flags = ZE_EVENT_POOL_FLAG_KERNEL_TIMESTAMP | ZE_EVENT_POOL_FLAG_HOST_VISIBLE;
+    SUCCESS_OR_TERMINATE( zeEventPoolCreate( context, &pool_descriptor, 1, &device, &event_pool ) );
+    ze_event_desc_t event_descriptor = { ZE_STRUCTURE_TYPE_EVENT_DESC };
+    event_descriptor.signal = ZE_EVENT_SCOPE_FLAG_HOST;
+    event_descriptor.wait = ZE_EVENT_SCOPE_FLAG_HOST;
+    SUCCESS_OR_TERMINATE( zeEventCreate( event_pool, &event_descriptor, &event ) );
+
+    ze_command_queue_desc_t queue_descriptor = { ZE_STRUCTURE_TYPE_COMMAND_QUEUE_DESC };
+    queue_descriptor.ordinal = slot.compute_ordinal;
+    queue_descriptor.mode = ZE_COMMAND_QUEUE_MODE_SYNCHRONOUS;
+    queue_descriptor.priority = ZE_COMMAND_QUEUE_PRIORITY_NORMAL;
+    SUCCESS_OR_TERMINATE( zeCommandListCreateImmediate( context, device, &queue_descriptor, &list ) );
+}
+
+kernel_probe::~kernel_probe()
+{
+    SUCCESS_OR_TERMINATE( zeCommandListDestroy( list ) );
+    SUCCESS_OR_TERMINATE( zeEventDestroy( event ) );
+    SUCCESS_OR_TERMINATE( zeEventPoolDestroy( event_pool ) );
+    for( auto buffer : buffers )
+        SUCCESS_OR_TERMINATE( zeMemFree( context, buffer ) );
+    SUCCESS_OR_TERMINATE( zeKernelDestroy( kernel ) );
+    SUCCESS_OR_TERMINATE( zeModuleDestroy( module ) );
+}
+
+double kernel_probe::measure( int counter, int runs )
+{
+    ze_group_count_t group_count = { (uint32_t)threads / 2, 1, 1 };
+    if( has_counter )
+        SUCCESS_OR_TERMINATE( zeKernelSetArgumentValue( kernel, 3, sizeof( int ), &counter ) );
+    std::vector<double> durations;
+    for( int run = 0; run <= runs; run++ )
+    {
+        SUCCESS_OR_TERMINATE( zeCommandListAppendLaunchKernel( list, kernel, &group_count, event, 0, nullptr ) );
+        SUCCESS_OR_TERMINATE( zeEventHostSynchronize( event, UINT64_MAX ) );
+        ze_kernel_timestamp_result_t timestamp = {};
+        SUCCESS_OR_TERMINATE( zeEventQueryKernelTimestamp( event, &timestamp ) );
+        SUCCESS_OR_TERMINATE( zeEventHostReset( event ) );
+        if( run > 0 )
+            durations.push_back( (double)( timestamp.context.kernelEnd - timestamp.context.kernelStart ) * timer_resolution );
+    }
+    std::sort( durations.begin(), durations.end() );
+    return durations[ durations.size() / 2 ];
+}
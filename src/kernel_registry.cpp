@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/kernel_registry.hpp"
+#include "ze_info/module_cache.hpp"
+#include "ze_info/ze_utils.hpp"
+
+#include <chrono>
+#include <fstream>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+static const char* kernel_name( graph_kernel kind )
+{
+    switch( kind )
+    {
+    case graph_kernel::cmp_bound:
+        return "cmp_bound_kernel";
+    case graph_kernel::mem_bound:
+        return "mem_bound_kernel";
+    case graph_kernel::add:
+        return "add_buffers";
+    case graph_kernel::copy:
+        return "copy_buffer";
+    case graph_kernel::set_n:
+        return "set_n_to_output";
+    }
+    return nullptr;
+}
+
+kernel_registry& kernel_registry::get()
+{
+    static kernel_registry instance;
+    return instance;
+}
+
+int64_t kernel_registry::resident_bytes()
+{
+#ifdef __linux__
+    std::ifstream statm( "/proc/self/statm" );
+    int64_t size = 0, resident = 0;
+    if( statm >> size >> resident )
+        return resident * sysconf( _SC_PAGESIZE );
+#endif
+    return 0;
+}
+
+void kernel_registry::create_kernels( ze_module_handle_t module, ze_kernel_handle_t* kernels )
+{
+    ze_kernel_desc_t kernel_descriptor = { ZE_STRUCTURE_TYPE_KERNEL_DESC };
+    for( int k = 0; k < graph_kernel_count; k++ )
+    {
+        kernel_descriptor.pKernelName = kernel_name( (graph_kernel)k );
+        SUCCESS_OR_TERMINATE( zeKernelCreate( module, &kernel_descriptor, &kernels[ k ] ) );
+        // copy_buffer has no required work group size, the others ask for this one
+        SUCCESS_OR_TERMINATE( zeKernelSetGroupSize( kernels[ k ], 32, 1, 1 ) );
+    }
+}
+
+void kernel_registry::destroy_kernels( ze_kernel_handle_t* kernels )
+{
+    for( int k = 0; k < graph_kernel_count; k++ )
+    {
+        if( kernels[ k ] )
+            SUCCESS_OR_TERMINATE( zeKernelDestroy( kernels[ k ] ) );
+        kernels[ k ] = nullptr;
+    }
+}
+
+kernel_set& kernel_registry::acquire( ze_context_handle_t context, ze_device_handle_t device, const std::vector<uint8_t>& spirv )
+{
+    std::lock_guard<std::mutex> lock( mtx );
+    std::unique_ptr<kernel_set>& set = sets[ { context, device } ];
+    if( !set )
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        int64_t rss = resident_bytes();
+        set.reset( new kernel_set );
+        set->context = context;
+        set->device = device;
+        set->module = module_cache::get().create_module( context, device, spirv );
+        create_kernels( set->module, set->kernels );
+        size_t size = 0;
+        if( zeModuleGetNativeBinary( set->module, &size, nullptr ) == ZE_RESULT_SUCCESS )
+            native_bytes += size;
+        module_rss_bytes += resident_bytes() - rss;
+        module_ns += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+        modules_created++;
+    }
+    set->users++;
+    return *set;
+}
+
+void kernel_registry::release( kernel_set& set )
+{
+    std::lock_guard<std::mutex> lock( mtx );
+    if( --set.users )
+        return;
+    destroy_kernels( set.kernels );
+    SUCCESS_OR_TERMINATE( zeModuleDestroy( set.module ) );
+    sets.erase( { set.context, set.device } );
+}
+
+void kernel_registry::record_zenon( int64_t rss_bytes, uint64_t ns )
+{
+    zenons++;
+    zenon_rss_bytes += rss_bytes;
+    zenon_ns += ns;
+}
+
+void kernel_registry::print_stats( std::ostream& out ) const
+{
+    const uint32_t modules = modules_created.load();
+    const uint32_t count = zenons.load();
+    if( !modules || !count )
+        return;
+    // a zenon used to pay for a module and its kernels, now only for what it keeps itself
+    const double module_kb = module_rss_bytes.load() / 1024.0 / modules;
+    const double own_kb = ( zenon_rss_bytes.load() - module_rss_bytes.load() ) / 1024.0 / count;
+    const double own_ms = ( zenon_ns.load() - (double)module_ns.load() ) / 1e6 / count;
+    out << "Kernel registry: " << modules << " module(s) for " << count << " zenons"
+        << " \t module + kernels: " << module_kb << " kB, " << module_ns.load() / 1e6 / modules << " ms, ISA " << native_bytes.load() / 1024.0 / modules << " kB each"
+        << " \t per zenon: " << own_kb << " kB, " << own_ms << " ms"
+        << " \t saved per zenon: ~" << module_kb - own_kb << " kB host, " << native_bytes.load() / 1024.0 / modules << " kB ISA\n";
+}
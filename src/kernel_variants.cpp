@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/kernel_variants.hpp"
+#include "ze_info/kernel_probe.hpp"
+#include "ze_info/graph_template.hpp"
+#include "ze_info/offline_compiler.hpp"
+#include "ze_info/module_cache.hpp"
+#include "ze_info/utils.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+kernel_variants& kernel_variants::get()
+{
+    static kernel_variants instance;
+    return instance;
+}
+
+const std::vector<uint8_t>& kernel_variants::spirv( const std::string& options )
+{
+    std::lock_guard<std::mutex> lock( mtx );
+    auto found = modules.find( options );
+    if( found != modules.end() )
+        return found->second;
+    std::vector<uint8_t>& module = modules[ options ];
+    module = module_cache::get().spirv( load_text_file( "module.cl" ), options, ocloc_device, [ & ]()
+    {
+        try
+        {
+            return generate_spirv( "module.cl", options );
+        }
+        catch( const std::runtime_error& )
+        {
+            std::cout << "module.cl does not build with \"" << options << "\"\n";
+            return std::vector<uint8_t>();
+        }
+    } );
+    return module;
+}
+
+size_t kernel_variants::size() const
+{
+    std::lock_guard<std::mutex> lock( mtx );
+    return modules.size();
+}
+
+std::string kernel_variants::specialization_options( int threads, int input_size, int mem_kb )
+{
+    std::string options = "-DSPEC_THREADS=" + std::to_string( threads ) + " -DSPEC_INPUT_SIZE=" + std::to_string( input_size );
+    if( mem_kb > 0 )
+        options += " -DSPEC_MEM_KB=" + std::to_string( mem_kb );
+    return options;
+}
+
+void compare_kernel_variants( const device_slot& slot, const graph_template& recorded, std::ostream& out )
+{
+    if( recorded.get_build_options().empty() )
+        return;
+    const std::vector<uint8_t>& generic = kernel_variants::get().spirv( "" );
+    if( generic.empty() )
+        return;
+
+    struct kernel_kind
+    {
+        graph_kernel kernel;
+        const char* name;
+        bool has_counter;
+        std::vector<int> counters;
+    };
+    kernel_kind kinds[] = {
+        { graph_kernel::add, "add_buffers", false, {} },
+        { graph_kernel::cmp_bound, "cmp_bound_kernel", true, {} },
+        { graph_kernel::mem_bound, "mem_bound_kernel", true, {} },
+    };
+    for( const launch_record& launch : recorded.get_launches() )
+    {
+        for( kernel_kind& kind : kinds )
+        {
+            if( kind.kernel == launch.kernel )
+                kind.counters.push_back( launch.counter );
+        }
+    }
+
+    out << "Kernel variants: generic vs " << recorded.get_build_options() << "\n";
+    for( kernel_kind& kind : kinds )
+    {
+        if( kind.counters.empty() )
+            continue;
+        // the median launch of the kind, the buffers fit the largest
+        std::sort( kind.counters.begin(), kind.counters.end() );
+        const int counter = kind.counters[ kind.counters.size() / 2 ];
+        size_t bytes = recorded.get_input_size();
+        if( kind.kernel == graph_kernel::mem_bound )
+            bytes *= std::max( 1, kind.counters.back() );
+        kernel_probe generic_probe( slot, generic, kind.name, kind.has_counter, recorded.get_threads(), recorded.get_input_size(), bytes );
+        kernel_probe specialized_probe( slot, recorded.get_spirv(), kind.name, kind.has_counter, recorded.get_threads(), recorded.get_input_size(), bytes );
+        const double generic_ns = generic_probe.measure( counter );
+        const double specialized_ns = specialized_probe.measure( counter );
+        out << "  " << std::left << std::setw( 17 ) << kind.name << std::right << std::fixed << std::setprecision( 0 )
+            << " \t generic: " << generic_ns << " ns \t specialized: " << specialized_ns << " ns ("
+            << std::showpos << std::setprecision( 1 ) << ( specialized_ns - generic_ns ) * 100.0 / generic_ns << std::noshowpos << "%)\n"
+            << std::defaultfloat;
+    }
+}
@@ -9,6 +9,12 @@
 #include "ze_info/capabilities.hpp"
 #include "ze_info/text_formatter.hpp"
 #include "ze_info/simple_run.hpp"
+#include "ze_info/utils.hpp"
+#include "ze_info/zenon_pool.hpp"
+#include "ze_info/scenario.hpp"
+#include "ze_info/device_topology.hpp"
+#include "ze_info/graph.hpp"
+#include "ze_info/cpu_kernels.hpp"
 #include "ze_api.h"
 
 #include <vector>
@@ -42,6 +48,29 @@ extern float compute_bound_kernel_multiplier;
 extern short number_of_threads;
 extern short memory_used_by_mem_bound_kernel;
 extern int input_size;
+extern std::vector<double> percentiles;
+extern std::string histogram_file;
+extern pool_wait_strategy pool_wait;
+extern int max_batch_size;
+extern int max_batch_wait_us;
+extern int deadline_us;
+extern int priority_levels;
+extern scenario_type scenario;
+extern int latency_target_us;
+extern int samples_per_query;
+extern int multi_stream_interval_us;
+extern std::string trace_path;
+extern std::string trace_out_path;
+extern int branch_lanes;
+extern bool immediate_cmd_lists;
+extern bool plan_memory;
+extern bool overlap_copies;
+extern bool zero_copy;
+extern bool cpu_backend;
+extern bool force_calibration;
+extern bool specialize_kernels;
+extern std::string module_cache_dir;
+extern std::string calibration_path;
 
 void print_help()
 {
@@ -62,6 +91,34 @@ void print_help()
     std::cout << "--t               - number of threads" << std::endl;
     std::cout << "--mem             - memory used by memory bound kernel in kB" << std::endl;
     std::cout << "--single_thread   - memory used by memory bound kernel in kB" << std::endl;
+    std::cout << "--percentiles     - comma separated latency percentiles to print (default 50,90,99,99.9)" << std::endl;
+    std::cout << "--hist_out        - save raw latency histogram buckets to file" << std::endl;
+    std::cout << "--pool_wait       - how to wait for a free zenon: spin (default), yield or park" << std::endl;
+    std::cout << "--batch           - max number of queries run as one batch (default 1 - no batching)" << std::endl;
+    std::cout << "--batch_wait      - max time in us a query waits for its batch to fill (default 1000)" << std::endl;
+    std::cout << "--deadline        - per query deadline in us from its send time, enables EDF scheduling and load shedding" << std::endl;
+    std::cout << "--priorities      - number of query priority levels, generated queries get one at random (default 1)" << std::endl;
+    std::cout << "--scenario        - single_stream, multi_stream, server (default) or offline" << std::endl;
+    std::cout << "--latency_target  - latency constraint in us for the single_stream (p90) and server (p99) scenarios" << std::endl;
+    std::cout << "--samples         - samples per query in the multi_stream scenario (default 8)" << std::endl;
+    std::cout << "--interval        - time in us between queries in the multi_stream scenario (default 50000)" << std::endl;
+    std::cout << "--trace           - replay arrival times from a binary trace file, overrides --q and --qps" << std::endl;
+    std::cout << "--trace_out       - save the generated arrival times as a binary trace file" << std::endl;
+    std::cout << "--graph           - run the network graph from a file instead of the built in one (see graph.hpp for the format)" << std::endl;
+    std::cout << "--branch_parallel - run independent graph branches on up to N command lists, one CCS each (default 1, serial)" << std::endl;
+    std::cout << "--immediate       - append every query to immediate command lists instead of executing recorded ones" << std::endl;
+    std::cout << "--fuse            - fuse linear chains of cmp_bound nodes into single launches, and measure the latency it saves" << std::endl;
+    std::cout << "--no_mem_plan     - allocate every intermediate tensor separately instead of packing them into one arena" << std::endl;
+    std::cout << "--overlap         - a second buffer set per zenon uploads the next query while the graph runs, the download is chained behind the graph" << std::endl;
+    std::cout << "--zero_copy       - upload straight from registered USM host payloads instead of filling the zenon's input vectors" << std::endl;
+    std::cout << "--backend B       - gpu (default) or cpu, cpu runs the graphs on a TBB flow graph in host memory" << std::endl;
+    std::cout << "--cpu_kernel_bench - time the host kernels at every SIMD level the CPU has (use with --input_size, --t, --mem) and check them against scalar" << std::endl;
+    std::cout << "--calibrate       - refit the cmp_bound_kernel duration model of every device at startup, otherwise it is only fitted for devices without a saved one" << std::endl;
+    std::cout << "--calibration_file - where the fitted models are kept (default calibration.txt)" << std::endl;
+    std::cout << "--generic_kernels - use the generic module.cl instead of the one specialized with -D defines for the configured sizes" << std::endl;
+    std::cout << "--module_cache    - directory of the SPIR-V and native binary cache (default module_cache)" << std::endl;
+    std::cout << "--no_module_cache - compile module.cl and build it for the device on every start" << std::endl;
+    std::cout << "--fake_devices    - D:S, run the server on D fake devices with S sub-devices each, graphs run on the cpu backend" << std::endl;
 }
 
 int main(int argc, const char** argv) {
@@ -77,6 +134,8 @@ int main(int argc, const char** argv) {
     bool multi_ccs = true;
     bool fixed_dist = false;
     bool warm_up = true;
+    int fake_devices = 0, fake_sub_devices = 0;
+    bool cpu_kernel_bench = false;
     single_thread = false;
     profiling = false;
     verbose = false;
@@ -176,6 +235,160 @@ int main(int argc, const char** argv) {
             input_size = atoi( argv[ i ] );
             
         }
+        else if( !strcmp( argv[ i ], "--percentiles" ) )
+        {
+            i++;
+            percentiles.clear();
+            for( const auto& p : split_string( argv[ i ], "," ) )
+                percentiles.push_back( atof( p.c_str() ) );
+        }
+        else if( !strcmp( argv[ i ], "--hist_out" ) )
+        {
+            i++;
+            histogram_file = argv[ i ];
+        }
+        else if( !strcmp( argv[ i ], "--pool_wait" ) )
+        {
+            i++;
+            if( !parse_pool_wait_strategy( argv[ i ], pool_wait ) )
+            {
+                std::cout << "Unknown pool wait strategy: " << argv[ i ];
+                print_help();
+                return 1;
+            }
+        }
+        else if( !strcmp( argv[ i ], "--batch" ) )
+        {
+            i++;
+            max_batch_size = std::max( 1, atoi( argv[ i ] ) );
+        }
+        else if( !strcmp( argv[ i ], "--batch_wait" ) )
+        {
+            i++;
+            max_batch_wait_us = std::max( 0, atoi( argv[ i ] ) );
+        }
+        else if( !strcmp( argv[ i ], "--deadline" ) )
+        {
+            i++;
+            deadline_us = std::max( 0, atoi( argv[ i ] ) );
+        }
+        else if( !strcmp( argv[ i ], "--priorities" ) )
+        {
+            i++;
+            priority_levels = std::max( 1, atoi( argv[ i ] ) );
+        }
+        else if( !strcmp( argv[ i ], "--scenario" ) )
+        {
+            i++;
+            if( !parse_scenario( argv[ i ], scenario ) )
+            {
+                std::cout << "Unknown scenario: " << argv[ i ];
+                print_help();
+                return 1;
+            }
+        }
+        else if( !strcmp( argv[ i ], "--latency_target" ) )
+        {
+            i++;
+            latency_target_us = atoi( argv[ i ] );
+        }
+        else if( !strcmp( argv[ i ], "--samples" ) )
+        {
+            i++;
+            samples_per_query = std::max( 1, atoi( argv[ i ] ) );
+        }
+        else if( !strcmp( argv[ i ], "--interval" ) )
+        {
+            i++;
+            multi_stream_interval_us = std::max( 1, atoi( argv[ i ] ) );
+        }
+        else if( !strcmp( argv[ i ], "--trace" ) )
+        {
+            i++;
+            trace_path = argv[ i ];
+        }
+        else if( !strcmp( argv[ i ], "--trace_out" ) )
+        {
+            i++;
+            trace_out_path = argv[ i ];
+        }
+        else if( !strcmp( argv[ i ], "--graph" ) )
+        {
+            i++;
+            graph_file = argv[ i ];
+        }
+        else if( !strcmp( argv[ i ], "--branch_parallel" ) )
+        {
+            i++;
+            branch_lanes = std::max( 1, atoi( argv[ i ] ) );
+        }
+        else if( !strcmp( argv[ i ], "--immediate" ) )
+        {
+            immediate_cmd_lists = true;
+        }
+        else if( !strcmp( argv[ i ], "--fuse" ) )
+        {
+            fuse_kernels = true;
+        }
+        else if( !strcmp( argv[ i ], "--no_mem_plan" ) )
+        {
+            plan_memory = false;
+        }
+        else if( !strcmp( argv[ i ], "--overlap" ) )
+        {
+            overlap_copies = true;
+        }
+        else if( !strcmp( argv[ i ], "--zero_copy" ) )
+        {
+            zero_copy = true;
+        }
+        else if( !strcmp( argv[ i ], "--backend" ) )
+        {
+            i++;
+            if( i >= argc || ( strcmp( argv[ i ], "cpu" ) && strcmp( argv[ i ], "gpu" ) ) )
+            {
+                std::cout << "Wrong --backend, expected cpu or gpu";
+                print_help();
+                return 1;
+            }
+            cpu_backend = !strcmp( argv[ i ], "cpu" );
+        }
+        else if( !strcmp( argv[ i ], "--cpu_kernel_bench" ) )
+        {
+            cpu_kernel_bench = true;
+        }
+        else if( !strcmp( argv[ i ], "--calibrate" ) )
+        {
+            force_calibration = true;
+        }
+        else if( !strcmp( argv[ i ], "--calibration_file" ) )
+        {
+            i++;
+            calibration_path = argv[ i ];
+        }
+        else if( !strcmp( argv[ i ], "--generic_kernels" ) )
+        {
+            specialize_kernels = false;
+        }
+        else if( !strcmp( argv[ i ], "--module_cache" ) )
+        {
+            i++;
+            module_cache_dir = argv[ i ];
+        }
+        else if( !strcmp( argv[ i ], "--no_module_cache" ) )
+        {
+            module_cache_dir.clear();
+        }
+        else if( !strcmp( argv[ i ], "--fake_devices" ) )
+        {
+            i++;
+            if( sscanf( argv[ i ], "%d:%d", &fake_devices, &fake_sub_devices ) < 1 || fake_devices < 1 )
+            {
+                std::cout << "Wrong --fake_devices format, expected D:S";
+                print_help();
+                return 1;
+            }
+        }
         /*else if (!strcmp(argv[i], "--run_mt"))
         {
             run_mt( queries, qps, consumers_count, multi_ccs, fixed_dist, warm_up, logging );
@@ -192,7 +405,42 @@ int main(int argc, const char** argv) {
         printf( "too high thread number, setting it to the same as input_size\n" );
         number_of_threads = input_size;
     }
+    if( cpu_kernel_bench )
+        return bench_cpu_kernels( std::cout, number_of_threads, input_size, memory_used_by_mem_bound_kernel ) ? 0 : 1;
+    if( single_thread && max_batch_size > 1 )
+    {
+        printf( "batching is not supported with --single_thread, disabling it\n" );
+        max_batch_size = 1;
+    }
+    // fake slots have no driver behind them, their zenons run the graph on the host
+    if( fake_devices > 0 )
+        cpu_backend = true;
+    if( cpu_backend && ( immediate_cmd_lists || overlap_copies || zero_copy || branch_lanes > 1 ) )
+    {
+        printf( "--immediate, --overlap, --zero_copy and --branch_parallel are GPU options, ignored with --backend cpu\n" );
+        immediate_cmd_lists = overlap_copies = zero_copy = false;
+        branch_lanes = 1;
+    }
+    // host memory needs no blitter, the graph's own set_n nodes fill the inputs
+    if( cpu_backend )
+        disable_blitter = true;
+    if( deadline_us > 0 && max_batch_size > 1 )
+        printf( "EDF scheduling is not used with --batch, only completed late queries are reported\n" );
+
+    const network_graph* graph = get_network_graph();
+    if( !graph )
+        return 1;
+    std::cout << "Graph: " << graph->get_name() << " nodes: " << graph->get_nodes().size() << std::endl;
+    if( fuse_kernels )
+        std::cout << "Fusion: launches per query: " << graph->unfused_size() << " -> " << graph->get_nodes().size() << std::endl;
+    if( branch_lanes > 1 )
+        graph->print_schedule( std::cout, branch_lanes );
 
+    // the host is a single slot, the flow graph itself spreads a query over the cores
+    if( fake_devices > 0 )
+        device_topology::get().enumerate_fake( fake_devices, fake_sub_devices );
+    else if( cpu_backend )
+        device_topology::get().enumerate_fake( 1, 0, 1 );
 
     run_mt(queries, qps, consumers_count, multi_ccs, fixed_dist, warm_up, logging);
 
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/memory_planner.hpp"
+
+#include <algorithm>
+
+memory_plan plan_intermediates( const network_graph& graph, const std::vector<size_t>& sizes, size_t alignment )
+{
+    const std::vector<graph_node>& nodes = graph.get_nodes();
+    const std::vector<graph_tensor>& tensors = graph.get_tensors();
+    memory_plan plan;
+    plan.offsets.assign( tensors.size(), memory_plan::not_planned );
+
+    // before[ n ][ m ]: node m finishes before node n starts
+    std::vector<std::vector<bool>> before( nodes.size(), std::vector<bool>( nodes.size(), false ) );
+    for( size_t n = 0; n < nodes.size(); n++ )
+    {
+        for( int dep : nodes[ n ].deps )
+        {
+            before[ n ][ dep ] = true;
+            for( size_t m = 0; m < nodes.size(); m++ )
+            {
+                if( before[ dep ][ m ] )
+                    before[ n ][ m ] = true;
+            }
+        }
+    }
+
+    std::vector<std::vector<int>> users( tensors.size() );
+    for( size_t n = 0; n < nodes.size(); n++ )
+    {
+        for( int input : nodes[ n ].inputs )
+            users[ input ].push_back( (int)n );
+        users[ nodes[ n ].output ].push_back( (int)n );
+    }
+    auto all_before = [ & ]( int a, int b )
+    {
+        for( int ua : users[ a ] )
+        {
+            for( int ub : users[ b ] )
+            {
+                if( !before[ ub ][ ua ] )
+                    return false;
+            }
+        }
+        return true;
+    };
+
+    std::vector<int> placed;
+    for( size_t t = 0; t < tensors.size(); t++ )
+    {
+        if( tensors[ t ].role != tensor_role::intermediate )
+            continue;
+        plan.naive_size += sizes[ t ];
+        if( users[ t ].empty() )
+            continue;
+        const size_t size = ( sizes[ t ] + alignment - 1 ) / alignment * alignment;
+
+        // ranges taken by tensors this one may overlap in time with, by offset
+        std::vector<std::pair<size_t, size_t>> taken;
+        for( int other : placed )
+        {
+            if( !all_before( other, (int)t ) && !all_before( (int)t, other ) )
+                taken.push_back( { plan.offsets[ other ], plan.offsets[ other ] + ( sizes[ other ] + alignment - 1 ) / alignment * alignment } );
+        }
+        std::sort( taken.begin(), taken.end() );
+        size_t offset = 0;
+        for( auto& range : taken )
+        {
+            if( range.first >= offset + size )
+                break;
+            offset = std::max( offset, range.second );
+        }
+        plan.offsets[ t ] = offset;
+        plan.arena_size = std::max( plan.arena_size, offset + size );
+        placed.push_back( (int)t );
+    }
+    return plan;
+}
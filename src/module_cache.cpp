@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/module_cache.hpp"
+#include "ze_info/ze_utils.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::string module_cache_dir = "module_cache";
+
+mapped_file::mapped_file( const std::string& path )
+{
+#ifdef __linux__
+    int fd = open( path.c_str(), O_RDONLY );
+    if( fd < 0 )
+        return;
+    struct stat info;
+    if( fstat( fd, &info ) == 0 && info.st_size > 0 )
+    {
+        void* address = mmap( nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if( address != MAP_FAILED )
+        {
+            bytes = static_cast<const uint8_t*>( address );
+            length = (size_t)info.st_size;
+            mapped = true;
+        }
+    }
+    close( fd );
+#else
+    std::ifstream in( path, std::ios::binary );
+    if( !in )
+        return;
+    buffer.assign( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+    bytes = buffer.data();
+    length = buffer.size();
+#endif
+}
+
+mapped_file::~mapped_file()
+{
+#ifdef __linux__
+    if( mapped )
+        munmap( const_cast<uint8_t*>( bytes ), length );
+#endif
+}
+
+module_cache& module_cache::get()
+{
+    static module_cache instance;
+    return instance;
+}
+
+module_cache::module_cache() :
+    directory( module_cache_dir )
+{
+}
+
+uint64_t module_cache::fnv1a( const void* data, size_t size, uint64_t hash )
+{
+    const uint8_t* p = static_cast<const uint8_t*>( data );
+    for( size_t i = 0; i < size; i++ )
+    {
+        hash ^= p[ i ];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string module_cache::hash_key( std::initializer_list<std::string> parts )
+{
+    uint64_t hash = fnv1a( nullptr, 0 );
+    for( const std::string& part : parts )
+    {
+        // the length keeps ("ab", "c") and ("a", "bc") apart
+        uint64_t size = part.size();
+        hash = fnv1a( &size, sizeof( size ), hash );
+        hash = fnv1a( part.data(), part.size(), hash );
+    }
+    char key[ 17 ];
+    snprintf( key, sizeof( key ), "%016llx", (unsigned long long)hash );
+    return key;
+}
+
+std::string module_cache::file_path( const std::string& key, const char* extension ) const
+{
+    return directory + "/" + key + extension;
+}
+
+void module_cache::store( const std::string& path, const uint8_t* data, size_t size )
+{
+    // written aside and renamed, a reader never sees half a file
+    std::error_code error;
+    std::filesystem::create_directories( directory, error );
+    const std::string temporary = path + "." + std::to_string( std::chrono::steady_clock::now().time_since_epoch().count() );
+    {
+        std::ofstream out( temporary, std::ios::binary );
+        if( !out.write( reinterpret_cast<const char*>( data ), size ) )
+            return;
+    }
+    if( std::rename( temporary.c_str(), path.c_str() ) != 0 )
+        std::remove( temporary.c_str() );
+}
+
+// what the native binary depends on besides the SPIR-V: the device and the driver building it
+static std::string device_signature( ze_device_handle_t device )
+{
+    ze_device_properties_t properties = { ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES };
+    SUCCESS_OR_TERMINATE( zeDeviceGetProperties( device, &properties ) );
+    uint32_t number_of_drivers = 1;
+    ze_driver_handle_t driver = nullptr;
+    SUCCESS_OR_TERMINATE( zeDriverGet( &number_of_drivers, &driver ) );
+    ze_driver_properties_t driver_properties = { ZE_STRUCTURE_TYPE_DRIVER_PROPERTIES };
+    SUCCESS_OR_TERMINATE( zeDriverGetProperties( driver, &driver_properties ) );
+    return std::to_string( properties.vendorId ) + ":" + std::to_string( properties.deviceId ) + ":" + properties.name
+        + ":" + std::to_string( driver_properties.driverVersion );
+}
+
+ze_module_handle_t module_cache::create_module( ze_context_handle_t context, ze_device_handle_t device, const std::vector<uint8_t>& spirv )
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    ze_module_desc_t module_descriptor = { ZE_STRUCTURE_TYPE_MODULE_DESC };
+    ze_module_handle_t module = nullptr;
+    {
+        std::lock_guard<std::mutex> lock( mtx );
+        const uint64_t spirv_hash = fnv1a( spirv.data(), spirv.size() );
+        const std::string path = file_path( hash_key( { std::to_string( spirv_hash ), device_signature( device ) } ), ".bin" );
+        if( enabled() )
+        {
+            std::unique_ptr<mapped_file>& binary = binaries[ path ];
+            if( !binary )
+                binary.reset( new mapped_file( path ) );
+            if( !binary->empty() )
+            {
+                module_descriptor.format = ZE_MODULE_FORMAT_NATIVE;
+                module_descriptor.inputSize = binary->size();
+                module_descriptor.pInputModule = binary->data();
+                // a binary the driver no longer takes is rebuilt from the SPIR-V
+                if( zeModuleCreate( context, device, &module_descriptor, &module, nullptr ) != ZE_RESULT_SUCCESS )
+                    module = nullptr;
+            }
+        }
+        if( module )
+            native_hits++;
+        else
+        {
+            native_misses++;
+            module_descriptor.format = ZE_MODULE_FORMAT_IL_SPIRV;
+            module_descriptor.inputSize = spirv.size();
+            module_descriptor.pInputModule = spirv.data();
+            SUCCESS_OR_TERMINATE( zeModuleCreate( context, device, &module_descriptor, &module, nullptr ) );
+            if( enabled() )
+            {
+                size_t size = 0;
+                SUCCESS_OR_TERMINATE( zeModuleGetNativeBinary( module, &size, nullptr ) );
+                std::vector<uint8_t> native( size );
+                SUCCESS_OR_TERMINATE( zeModuleGetNativeBinary( module, &size, native.data() ) );
+                store( path, native.data(), size );
+                binaries[ path ].reset( new mapped_file( path ) );
+            }
+        }
+    }
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+    create_count++;
+    create_ns_total += ns;
+    uint64_t max_ns = create_ns_max.load();
+    while( ns > max_ns && !create_ns_max.compare_exchange_weak( max_ns, ns ) );
+    return module;
+}
+
+void module_cache::print_stats( std::ostream& out ) const
+{
+    uint64_t count = create_count.load();
+    out << "Module cache (" << ( enabled() ? directory : "off" ) << ", " << ( spirv_misses.load() || native_misses.load() ? "cold" : "warm" ) << " start):"
+        << " SPIR-V hits: " << spirv_hits.load() << " misses: " << spirv_misses.load()
+        << " \t native hits: " << native_hits.load() << " misses: " << native_misses.load()
+        << " \t module create avg: " << ( count ? create_ns_total.load() / count / 1e6 : 0.0 ) << " ms"
+        << " max: " << create_ns_max.load() / 1e6 << " ms\n";
+}
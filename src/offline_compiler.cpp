@@ -22,6 +22,9 @@
 
 
 
+    // TODO: Device detection is required
+    const char* const ocloc_device = "skl";
+
     std::vector<uint8_t> generate_spirv(const std::string& cl_file_path, const std::string& build_options)
     {
 
@@ -31,8 +34,7 @@
 
         std::string source = load_text_file(src_file);
 
-        // TODO: Device detection is required
-        const std::string device = "skl";
+        const std::string device = ocloc_device;
 
         std::vector<const char*> args = {
             "ocloc",   "-q", "compile",  "-device",   device.c_str(),
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/scenario.hpp"
+
+bool parse_scenario( const std::string& name, scenario_type& scenario )
+{
+    if( name == "single_stream" )
+        scenario = scenario_type::single_stream;
+    else if( name == "multi_stream" )
+        scenario = scenario_type::multi_stream;
+    else if( name == "server" )
+        scenario = scenario_type::server;
+    else if( name == "offline" )
+        scenario = scenario_type::offline;
+    else
+        return false;
+    return true;
+}
+
+const char* to_string( scenario_type scenario )
+{
+    switch( scenario )
+    {
+    case scenario_type::single_stream:
+        return "SingleStream";
+    case scenario_type::multi_stream:
+        return "MultiStream";
+    case scenario_type::server:
+        return "Server";
+    case scenario_type::offline:
+        return "Offline";
+    }
+    return "Unknown";
+}
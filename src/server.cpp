@@ -7,3 +7,9 @@
 
 #include "ze_info/server.hpp"
 
+
+pool_wait_strategy pool_wait = pool_wait_strategy::spin;
+int max_batch_size = 1;
+int max_batch_wait_us = 1000;
+int deadline_us = 0;
+int priority_levels = 1;
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/trace.hpp"
+
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool trace_file::open( const std::string& file_path )
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA( file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+    if( file == INVALID_HANDLE_VALUE )
+        return false;
+    LARGE_INTEGER file_size;
+    if( !GetFileSizeEx( file, &file_size ) || file_size.QuadPart < (LONGLONG)sizeof( trace_header ) )
+    {
+        CloseHandle( file );
+        return false;
+    }
+    HANDLE map = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    void* view = map ? MapViewOfFile( map, FILE_MAP_READ, 0, 0, 0 ) : nullptr;
+    if( !view )
+    {
+        if( map )
+            CloseHandle( map );
+        CloseHandle( file );
+        return false;
+    }
+    file_handle = file;
+    map_handle = map;
+    mapping = view;
+    mapping_size = (size_t)file_size.QuadPart;
+#else
+    int fd = ::open( file_path.c_str(), O_RDONLY );
+    if( fd < 0 )
+        return false;
+    struct stat st;
+    if( fstat( fd, &st ) || st.st_size < (off_t)sizeof( trace_header ) )
+    {
+        ::close( fd );
+        return false;
+    }
+    void* view = mmap( nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    // the mapping keeps its own reference to the file
+    ::close( fd );
+    if( view == MAP_FAILED )
+        return false;
+    // replay reads the records front to back exactly once
+    madvise( view, (size_t)st.st_size, MADV_SEQUENTIAL );
+    mapping = view;
+    mapping_size = (size_t)st.st_size;
+#endif
+
+    const trace_header* header = static_cast<const trace_header*>( mapping );
+    if( memcmp( header->magic, "ZETR", 4 ) || header->version != version ||
+        header->count > ( mapping_size - sizeof( trace_header ) ) / sizeof( trace_record ) )
+    {
+        close();
+        return false;
+    }
+    records = reinterpret_cast<const trace_record*>( static_cast<const char*>( mapping ) + sizeof( trace_header ) );
+    count = (size_t)header->count;
+    return true;
+}
+
+void trace_file::close()
+{
+    if( !mapping )
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile( mapping );
+    CloseHandle( map_handle );
+    CloseHandle( file_handle );
+    map_handle = nullptr;
+    file_handle = nullptr;
+#else
+    munmap( mapping, mapping_size );
+#endif
+    mapping = nullptr;
+    mapping_size = 0;
+    records = nullptr;
+    count = 0;
+}
+
+bool trace_file::write( const std::string& file_path, const std::vector<trace_record>& records )
+{
+    std::ofstream out( file_path, std::ios::binary );
+    if( !out )
+        return false;
+    trace_header header;
+    memcpy( header.magic, "ZETR", 4 );
+    header.version = version;
+    header.count = records.size();
+    out.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+    out.write( reinterpret_cast<const char*>( records.data() ), records.size() * sizeof( trace_record ) );
+    return (bool)out;
+}
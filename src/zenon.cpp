@@ -24,12 +24,23 @@
 #include "ze_info/offline_compiler.hpp"
 #include "ze_info/zenon.hpp"
 #include "ze_info/ze_utils.hpp"
+#include "ze_info/graph.hpp"
+#include "ze_info/graph_template.hpp"
+#include "ze_info/memory_planner.hpp"
+#include "ze_info/module_cache.hpp"
 
 extern bool verbose, profiling, resnet, disable_blitte, single_thread;
 extern float compute_bound_kernel_multiplier;
 extern short number_of_threads;
 extern short memory_used_by_mem_bound_kernel;
 extern int input_size;
+extern int max_batch_size;
+extern int branch_lanes;
+extern bool immediate_cmd_lists;
+extern bool plan_memory;
+extern bool overlap_copies;
+extern bool zero_copy;
+extern bool cpu_backend;
 bool verbose = false;
 bool profiling = false;
 bool single_thread = false;
@@ -39,20 +50,73 @@ float compute_bound_kernel_multiplier = 1.0;
 short memory_used_by_mem_bound_kernel = 1;
 short number_of_threads = 32;
 int input_size = 4096;
+int branch_lanes = 1;
+bool immediate_cmd_lists = false;
+bool plan_memory = true;
+bool overlap_copies = false;
+bool zero_copy = false;
+bool cpu_backend = false;
 
 
 std::vector <ze_event_handle_t> global_kernel_ts_event;
 
-zenon::zenon(bool _log, bool _multi_ccs)
+// Host time of one kind of round trip a query makes: the input upload, the
+// compute submission and the output download.
+struct round_trip_stats
+{
+    std::atomic<uint64_t> ns_total{ 0 };
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> ns_max{ 0 };
+
+    void print( std::ostream& out, const char* name ) const
+    {
+        uint64_t n = count.load();
+        out << "  " << name << ": " << n << " \t avg: " << ( n ? ns_total.load() / n / 1000.0 : 0.0 ) << " us"
+            << " \t max: " << ns_max.load() / 1000.0 << " us\n";
+    }
+};
+
+// records the time from its construction to the end of the scope
+class round_trip_timer
+{
+public:
+    explicit round_trip_timer( round_trip_stats& _stats ) :
+        stats( _stats ),
+        start( std::chrono::high_resolution_clock::now() )
+    {
+    }
+
+    ~round_trip_timer()
+    {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+        stats.ns_total += ns;
+        stats.count++;
+        uint64_t max_ns = stats.ns_max.load();
+        while( ns > max_ns && !stats.ns_max.compare_exchange_weak( max_ns, ns ) );
+    }
+
+private:
+    round_trip_stats& stats;
+    std::chrono::high_resolution_clock::time_point start;
+};
+
+static round_trip_stats input_copy_stats, submit_stats, output_copy_stats;
+
+zenon::zenon(bool _log, bool _multi_ccs, size_t _slot, const graph_template* recording)
 {
     log = _log;
     multi_ccs = _multi_ccs;
-    input1 = new std::vector<uint8_t>( input_size, 0);
-    input2 = new std::vector<uint8_t>( input_size, 0);
-    output = new std::vector<uint8_t>( input_size, 0);
-    mem_input1 = new std::vector<uint8_t>(input_size * memory_used_by_mem_bound_kernel, 0);
-    mem_input2 = new std::vector<uint8_t>(input_size * memory_used_by_mem_bound_kernel, 0);
-    mem_output = new std::vector<uint8_t>(input_size * memory_used_by_mem_bound_kernel, 0);
+    slot = _slot;
+    input1 = new std::vector<uint8_t>( input_size * max_batch_size, 0);
+    input2 = new std::vector<uint8_t>( input_size * max_batch_size, 0);
+    output = new std::vector<uint8_t>( input_size * max_batch_size, 0);
+    recorded_graph = recording ? recording : &graph_template::get();
+    graph = &recorded_graph->get_graph();
+    // mem_bound nodes may ask for more than --mem, the mem buffers fit the largest
+    const size_t mem_kb = graph->max_mem_kb(memory_used_by_mem_bound_kernel);
+    mem_input1 = new std::vector<uint8_t>(input_size * mem_kb * max_batch_size, 0);
+    mem_input2 = new std::vector<uint8_t>(input_size * mem_kb * max_batch_size, 0);
+    mem_output = new std::vector<uint8_t>(input_size * mem_kb * max_batch_size, 0);
     init();
 }
 
@@ -61,100 +125,31 @@ zenon::zenon(std::vector<uint8_t>* in1, std::vector<uint8_t>* in2, std::vector<u
     input1 = in1;
     input2 = in2;
     output = out;
+    recorded_graph = &graph_template::get();
+    graph = &recorded_graph->get_graph();
     init();
 }
 
 void zenon::init()
 {
-    if (!ze_initalized)
+    device_topology& topology = device_topology::get();
+    if (!topology.is_enumerated())
     {
         if (log)
             std::cout << "Initalization start\n";
-        SUCCESS_OR_TERMINATE(zeInit(ZE_INIT_FLAG_GPU_ONLY));
-        ze_initalized = true;
-        SUCCESS_OR_TERMINATE(zeDriverGet(&number_of_drivers, nullptr));
-
-        if (log)
-            std::cout << "Number of drivers: " << number_of_drivers << std::endl;
-
-        drivers.resize(number_of_drivers);
-        SUCCESS_OR_TERMINATE(zeDriverGet(&number_of_drivers, drivers.data()));
-        driver = drivers[0];
-        context_descriptor.stype = ZE_STRUCTURE_TYPE_CONTEXT_DESC;
-        SUCCESS_OR_TERMINATE(zeContextCreate(driver, &context_descriptor, &context));
-
-        SUCCESS_OR_TERMINATE(zeDeviceGet(driver, &number_of_devices, nullptr));
-
-        devices.resize(number_of_devices);
-        SUCCESS_OR_TERMINATE(zeDeviceGet(driver, &number_of_devices, devices.data()));
-        ze_device_properties_t device_properties;
-
-        if (log)
-        {
-            std::cout << "number of devices: " << number_of_devices << std::endl;
-        }
-        device = devices[0];
-        for (uint32_t d = 0; d < number_of_devices; ++d) {
-            zeDeviceGetProperties(devices[d], &device_properties);
-            if (ZE_DEVICE_TYPE_GPU == device_properties.type) {
-                if (log)
-                {
-                    std::cout << "GPU device found:" << std::hex << device_properties.deviceId << std::endl;
-                }
-                if (!(device_properties.flags & ZE_DEVICE_PROPERTY_FLAG_INTEGRATED))
-                {
-                    if (log)
-                    {
-                        std::cout << "Device is discrete!" << std::endl;
-                    }
-                    device = devices[d];
-                    break;
-                }
-            }
-        }
-        // Discover all command queue groups
-        uint32_t cmdqueueGroupCount = 0;
-        zeDeviceGetCommandQueueGroupProperties(device, &cmdqueueGroupCount, nullptr);
-
-        ze_command_queue_group_properties_t* cmdqueueGroupProperties = (ze_command_queue_group_properties_t*)
-            malloc(cmdqueueGroupCount * sizeof(ze_command_queue_group_properties_t));
-        zeDeviceGetCommandQueueGroupProperties(device, &cmdqueueGroupCount, cmdqueueGroupProperties);
-
-        // Find a command queue type that support compute
-        computeQueueGroupOrdinal = cmdqueueGroupCount;
-        for (uint32_t i = 0; i < cmdqueueGroupCount; ++i) {
-            if (cmdqueueGroupProperties[i].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COMPUTE) {
-                computeQueueGroupOrdinal = i;
-            }
-
-            if (!(cmdqueueGroupProperties[i].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COMPUTE) &&
-                (cmdqueueGroupProperties[i].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COPY))
-            {
-                copyOnlyQueueGroupOrdinal = i;
-                break;
-            }
-        }
-
-        command_queue_count = cmdqueueGroupProperties[computeQueueGroupOrdinal].numQueues;
-
-        //if( !( device_properties.flags & ZE_DEVICE_PROPERTY_FLAG_INTEGRATED ) )
-        //    command_queue_count += cmdqueueGroupProperties[ copyOnlyQueueGroupOrdinal ].numQueues;
-
+        topology.enumerate(log);
     }
-
-    command_queue_descriptor.stype = ZE_STRUCTURE_TYPE_COMMAND_QUEUE_DESC;
-    command_queue_descriptor.ordinal = computeQueueGroupOrdinal;
-    command_queue_descriptor.mode = ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS;
-    command_queue_descriptor.priority = ZE_COMMAND_QUEUE_PRIORITY_NORMAL;
-    ccs_id = (zenon_cntr++) % command_queue_count;
+    placed = &topology.slot(slot);
+    placed->zenon_count++;
+    if (cpu_backend)
+        return;
+    device = placed->device;
+    context = placed->context;
+    computeQueueGroupOrdinal = placed->compute_ordinal;
+    copyOnlyQueueGroupOrdinal = placed->copy_ordinal;
+    cmp_bound_model = calibration_store::get().model(device);
     if (log)
-        std::cout << "command_queue_count: " << command_queue_count << std::endl;
-
-    if (!multi_ccs)
-        ccs_id = 0;
-    command_queue_descriptor.index = ccs_id;
-
-    SUCCESS_OR_TERMINATE(zeCommandQueueCreate(context, device, &command_queue_descriptor, &command_queue));
+        std::cout << "zenon on " << placed->name() << " command_queue_count: " << placed->compute_queue_count << std::endl;
 
     input_copy_command_queue_descriptor.stype = ZE_STRUCTURE_TYPE_COMMAND_QUEUE_DESC;
     input_copy_command_queue_descriptor.pNext = nullptr;
@@ -176,17 +171,33 @@ void zenon::init()
 }
 zenon::~zenon()
 {
-    zenon_cntr--;
-    if (!disable_blitter)
+    if (cpu_backend)
+    {
+        cpu.reset();
+        placed->zenon_count--;
+        delete input1;
+        delete input2;
+        delete output;
+        return;
+    }
+
+    if (input_copy_command_list)
         SUCCESS_OR_TERMINATE(zeCommandListDestroy(input_copy_command_list));
 
     SUCCESS_OR_TERMINATE(zeCommandQueueDestroy(input_copy_command_queue));
 
-    SUCCESS_OR_TERMINATE(zeCommandListDestroy(output_copy_command_list));
+    if (output_copy_command_list)
+        SUCCESS_OR_TERMINATE(zeCommandListDestroy(output_copy_command_list));
 
     SUCCESS_OR_TERMINATE(zeCommandQueueDestroy(output_copy_command_queue));
 
-    SUCCESS_OR_TERMINATE(zeCommandListDestroy(command_list));
+    for (auto list : lane_lists)
+        SUCCESS_OR_TERMINATE(zeCommandListDestroy(list));
+
+    if (immediate_copy_list)
+        SUCCESS_OR_TERMINATE(zeCommandListDestroy(immediate_copy_list));
+    for (auto list : immediate_compute_lists)
+        SUCCESS_OR_TERMINATE(zeCommandListDestroy(list));
 
     SUCCESS_OR_TERMINATE(zeMemFree(context, output_buffer));
 
@@ -194,33 +205,39 @@ zenon::~zenon()
 
     SUCCESS_OR_TERMINATE(zeMemFree(context, input2_buffer));
 
-    SUCCESS_OR_TERMINATE(zeMemFree(context, mem_output_buffer));
+    // a twin's intermediates are freed by their owner
+    if (intermediate_arena)
+        SUCCESS_OR_TERMINATE(zeMemFree(context, intermediate_arena));
+    else if (!intermediates_owner)
+    {
+        for (size_t t = 0; t < tensor_buffers.size(); t++)
+        {
+            if (graph->get_tensors()[t].role == tensor_role::intermediate)
+                SUCCESS_OR_TERMINATE(zeMemFree(context, tensor_buffers[t]));
+        }
+    }
 
     SUCCESS_OR_TERMINATE(zeMemFree(context, mem_input1_buffer));
 
     SUCCESS_OR_TERMINATE(zeMemFree(context, mem_input2_buffer));
 
-    SUCCESS_OR_TERMINATE(zeKernelDestroy(kernel));
-
-    SUCCESS_OR_TERMINATE(zeModuleDestroy(module));
+    kernel_registry::destroy_kernels(own_kernels);
+    if (shared_kernels)
+        kernel_registry::get().release(*shared_kernels);
 
-    if (ze_initalized && zenon_cntr == 0)
+    for (auto event : kernel_ts_event)
+        SUCCESS_OR_TERMINATE(zeEventDestroy(event));
+    SUCCESS_OR_TERMINATE(zeEventPoolDestroy(event_pool));
+    if (output_ready_event)
     {
-        SUCCESS_OR_TERMINATE(zeEventDestroy(*kernel_ts_event));
-        SUCCESS_OR_TERMINATE(zeEventPoolDestroy(event_pool));
-
-        for (uint32_t i = 0; i < command_queue_count; i++)
-        {
-            SUCCESS_OR_TERMINATE(zeCommandQueueDestroy(command_queue));
-            SUCCESS_OR_TERMINATE(zeCommandQueueDestroy(input_copy_command_queue));
-            SUCCESS_OR_TERMINATE(zeCommandQueueDestroy(output_copy_command_queue));
-        }
-
-        SUCCESS_OR_TERMINATE(zeContextDestroy(context));
-
-        ze_initalized = false;
+        SUCCESS_OR_TERMINATE(zeEventDestroy(input_ready_event));
+        SUCCESS_OR_TERMINATE(zeEventDestroy(output_ready_event));
+        SUCCESS_OR_TERMINATE(zeEventPoolDestroy(copy_event_pool));
     }
 
+    placed->zenon_count--;
+    // the context belongs to the device_topology and outlives its zenons
+
     delete input1;
     delete input2;
     delete output;
@@ -228,35 +245,26 @@ zenon::~zenon()
 
 void zenon::create_module(const std::string& cl_file_path)
 {
-    const std::vector<uint8_t> spirv = generate_spirv("module.cl", "");
-    module_descriptor.stype = ZE_STRUCTURE_TYPE_MODULE_DESC;
-    module_descriptor.format = ZE_MODULE_FORMAT_IL_SPIRV;
-    module_descriptor.inputSize = spirv.size();
-    module_descriptor.pInputModule = spirv.data();
-    SUCCESS_OR_TERMINATE(zeModuleCreate(context, device, &module_descriptor, &module, nullptr));
-
-    kernel_descriptor.stype = ZE_STRUCTURE_TYPE_KERNEL_DESC;
-    kernel_descriptor.pKernelName = "copy_buffer";
-
-    SUCCESS_OR_TERMINATE(zeKernelCreate(module, &kernel_descriptor, &kernel));
-
-    kernel_descriptor.pKernelName = "heavy";
-    SUCCESS_OR_TERMINATE(zeKernelCreate(module, &kernel_descriptor, &heavy_kernel));
-
-    kernel_descriptor.pKernelName = "add_buffers";
-    SUCCESS_OR_TERMINATE(zeKernelCreate(module, &kernel_descriptor, &add_buffers_kernel));
-
-    kernel_descriptor.pKernelName = "mul_buffers";
-    SUCCESS_OR_TERMINATE(zeKernelCreate(module, &kernel_descriptor, &mul_buffers_kernel));
-
-    kernel_descriptor.pKernelName = "cmp_bound_kernel";
-    SUCCESS_OR_TERMINATE(zeKernelCreate(module, &kernel_descriptor, &cmp_bound_kernel));
-
-    kernel_descriptor.pKernelName = "mem_bound_kernel";
-    SUCCESS_OR_TERMINATE(zeKernelCreate(module, &kernel_descriptor, &mem_bound_kernel));
+    if (cpu_backend)
+        return;
+    auto start = std::chrono::high_resolution_clock::now();
+    int64_t rss = kernel_registry::resident_bytes();
+    // compiled once for every zenon, the driver's build of it comes from the module cache
+    // and is loaded once per context and device
+    shared_kernels = &kernel_registry::get().acquire(context, device, recorded_graph->get_spirv());
+    // immediate lists bind arguments per query, while the other zenons do the same
+    if (immediate_cmd_lists)
+        kernel_registry::create_kernels(shared_kernels->module, own_kernels);
+    kernel_registry::get().record_zenon(kernel_registry::resident_bytes() - rss,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count());
+}
 
-    kernel_descriptor.pKernelName = "set_n_to_output";
-    SUCCESS_OR_TERMINATE(zeKernelCreate(module, &kernel_descriptor, &set_n_to_output));
+void zenon::share_intermediates(zenon& owner)
+{
+    intermediates_owner = &owner;
+    if (!owner.order)
+        owner.order = std::make_shared<compute_order>();
+    order = owner.order;
 }
 
 void zenon::allocate_buffers()
@@ -266,344 +274,370 @@ void zenon::allocate_buffers()
     auto alloc_size = sizeof(uint8_t) * input1->size();
     auto alloc_size_mem_buffers = sizeof( uint8_t ) * mem_input1->size();
 
-    SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-        alloc_size, 1, device, &input1_buffer));
-
-    SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-        alloc_size, 1, device, &input2_buffer));
-
-    SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-        alloc_size, 1, device, &im_buf1));
-
-    SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-        alloc_size_mem_buffers, 1, device, &mem_input1_buffer));
-
-    SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-        alloc_size_mem_buffers, 1, device, &mem_input2_buffer));
-
-    SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-        alloc_size_mem_buffers, 1, device, &mem_output_buffer));
-
+    if (cpu_backend) {
+        // the kernels read and write the host vectors directly
+        input1_buffer = input1->data();
+        input2_buffer = input2->data();
+        mem_input1_buffer = mem_input1->data();
+        mem_input2_buffer = mem_input2->data();
+        output_buffer = output->data();
+    }
+    else {
         SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-        alloc_size_mem_buffers, 1, device, &mem_output_buffer2));
-
-    SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-        alloc_size, 1, device, &im_buf2));
-    SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-        alloc_size, 1, device,
-        &im_buf3));
-    SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-        alloc_size, 1, device, &im_buf4));
+            alloc_size, 1, device, &input1_buffer));
 
-    SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-        alloc_size, 1, device, &im_buf5));
+        SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
+            alloc_size, 1, device, &input2_buffer));
 
-    SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-        alloc_size, 1, device, &im_buf6));
+        SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
+            alloc_size_mem_buffers, 1, device, &mem_input1_buffer));
 
-    if (disable_blitter) {
-        hostDesc.flags = ZE_HOST_MEM_ALLOC_FLAG_BIAS_UNCACHED;
-        SUCCESS_OR_TERMINATE(zeMemAllocShared(context, &memory_descriptor, &hostDesc, alloc_size, 1, device, &output_buffer));
-    }
-    else {
         SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
-            alloc_size, 1, device, &output_buffer));
+            alloc_size_mem_buffers, 1, device, &mem_input2_buffer));
+
+        if (disable_blitter) {
+            hostDesc.flags = ZE_HOST_MEM_ALLOC_FLAG_BIAS_UNCACHED;
+            SUCCESS_OR_TERMINATE(zeMemAllocShared(context, &memory_descriptor, &hostDesc, alloc_size, 1, device, &output_buffer));
+        }
+        else {
+            SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor,
+                alloc_size, 1, device, &output_buffer));
+        }
     }
-}
 
-void zenon::submit_kernel_to_cmd_list(ze_kernel_handle_t& _kernel,
-    std::vector<void*> input,
-    void* output,
-    ze_event_handle_t output_event,
-    std::vector<ze_event_handle_t*> input_events,
-    uint32_t input_event_count,
-    int number_of_threads,
-    int input_size)
-{
-    int param_cnt = 0;
-    for (int i = 0; i < input.size(); i++)
+    // one buffer per graph tensor, the zenon's own inputs and output are reused
+    // and the intermediates share one arena unless --no_mem_plan
+    const std::vector<graph_tensor>& tensors = graph->get_tensors();
+    std::vector<size_t> sizes(tensors.size());
+    for (size_t t = 0; t < tensors.size(); t++)
+        sizes[t] = tensors[t].mem_sized ? alloc_size_mem_buffers : alloc_size;
+    memory_plan plan = plan_intermediates(*graph, sizes);
+    naive_intermediate_bytes = plan.naive_size;
+    tensor_bytes = sizes;
+    intermediate_bytes = intermediates_owner ? 0 : plan_memory ? plan.arena_size : plan.naive_size;
+    if (intermediates_owner)
     {
-        SUCCESS_OR_TERMINATE(zeKernelSetArgumentValue(_kernel, param_cnt++, sizeof(input1_buffer), &input.at(i)));
+        // a twin's intermediate tensors point into its owner's, below
     }
-    SUCCESS_OR_TERMINATE(zeKernelSetArgumentValue(_kernel, param_cnt++, sizeof(output_buffer), &output));
-    SUCCESS_OR_TERMINATE( zeKernelSetArgumentValue( _kernel, param_cnt++, sizeof( int ), &number_of_threads ) );
-    SUCCESS_OR_TERMINATE( zeKernelSetArgumentValue( _kernel, param_cnt++, sizeof( int ), &input_size ) );
-    SUCCESS_OR_TERMINATE(zeCommandListAppendLaunchKernel(command_list, _kernel, &group_count,
-        output_event, input_event_count, input_events.at(0)));
-    graph_event_count++;
-    if (profiling)
+    else if (cpu_backend)
+    {
+        // with --no_mem_plan every intermediate gets its own slice of the host arena
+        cpu_arena.assign(intermediate_bytes, 0);
+        intermediate_arena = cpu_arena.data();
+    }
+    else if (plan_memory && plan.arena_size)
+        SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor, plan.arena_size, 1, device, &intermediate_arena));
+
+    tensor_buffers.assign(tensors.size(), nullptr);
+    size_t naive_offset = 0;
+    for (size_t t = 0; t < tensors.size(); t++)
     {
-        size_t kernel_name_length = 0;
-        SUCCESS_OR_TERMINATE(zeKernelGetName(_kernel, &kernel_name_length, nullptr));
-        char* kernel_name = new char[kernel_name_length];
-        SUCCESS_OR_TERMINATE(zeKernelGetName(_kernel, &kernel_name_length, kernel_name));
-        kernel_names.push_back(kernel_name);
+        switch (tensors[t].role)
+        {
+        case tensor_role::input1:
+            tensor_buffers[t] = input1_buffer;
+            break;
+        case tensor_role::input2:
+            tensor_buffers[t] = input2_buffer;
+            break;
+        case tensor_role::mem_input1:
+            tensor_buffers[t] = mem_input1_buffer;
+            break;
+        case tensor_role::mem_input2:
+            tensor_buffers[t] = mem_input2_buffer;
+            break;
+        case tensor_role::output:
+            tensor_buffers[t] = output_buffer;
+            break;
+        case tensor_role::intermediate:
+            if (intermediates_owner)
+                tensor_buffers[t] = intermediates_owner->tensor_buffers[t];
+            else if (cpu_backend && !plan_memory)
+            {
+                tensor_buffers[t] = cpu_arena.data() + naive_offset;
+                naive_offset += sizes[t];
+            }
+            else if (!plan_memory)
+                SUCCESS_OR_TERMINATE(zeMemAllocDevice(context, &memory_descriptor, sizes[t], 1, device, &tensor_buffers[t]));
+            else if (plan.offsets[t] != memory_plan::not_planned)
+                tensor_buffers[t] = static_cast<uint8_t*>(intermediate_arena) + plan.offsets[t];
+            break;
+        }
     }
 }
 
-void zenon::submit_kernel_to_cmd_list(ze_kernel_handle_t& _kernel,
-    std::vector<void*> input,
-    void* output,
-    ze_event_handle_t output_event,
-    std::vector<ze_event_handle_t*> input_events,
-    uint32_t input_event_count,
-    int time_in_nanoseconds,
-    int number_of_threads,
-    int input_size)
+ze_kernel_handle_t zenon::get_kernel(graph_kernel kind)
 {
-    int param_cnt = 0;
-    int counter = 0;
-
-    if (_kernel == cmp_bound_kernel) {
-        counter = (int)(time_in_nanoseconds * compute_bound_kernel_multiplier * 0.0114416 - 37.4022);
-    }
-    else if (_kernel == mem_bound_kernel) {
-        counter = (int)(memory_used_by_mem_bound_kernel);
-    }
-    else if (_kernel == set_n_to_output) {
-        counter = time_in_nanoseconds;
-    }
+    if (own_kernels[(int)kind])
+        return own_kernels[(int)kind];
+    return shared_kernels->get(kind);
+}
 
-    for (int i = 0; i < input.size(); i++)
+void zenon::submit_kernel_to_cmd_list(ze_command_list_handle_t list, const launch_record& launch, int number_of_threads, int input_size)
+{
+    ze_kernel_handle_t _kernel = get_kernel(launch.kernel);
+    int param_cnt = 0;
+    for (int input : launch.inputs)
     {
-        SUCCESS_OR_TERMINATE(zeKernelSetArgumentValue(_kernel, param_cnt++, sizeof(input1_buffer), &input.at(i)));
+        SUCCESS_OR_TERMINATE(zeKernelSetArgumentValue(_kernel, param_cnt++, sizeof(void*), &tensor_buffers[input]));
     }
-    SUCCESS_OR_TERMINATE(zeKernelSetArgumentValue(_kernel, param_cnt++, sizeof(output_buffer), &output));
-
-    SUCCESS_OR_TERMINATE(zeKernelSetArgumentValue(_kernel, param_cnt++, sizeof(int), &counter));
+    SUCCESS_OR_TERMINATE(zeKernelSetArgumentValue(_kernel, param_cnt++, sizeof(void*), &tensor_buffers[launch.output]));
+    const int counter = launch.kernel == graph_kernel::cmp_bound ? cmp_bound_model.counter(launch.target_ns) : launch.counter;
+    if (launch.has_counter)
+        SUCCESS_OR_TERMINATE(zeKernelSetArgumentValue(_kernel, param_cnt++, sizeof(int), &counter));
     SUCCESS_OR_TERMINATE( zeKernelSetArgumentValue( _kernel, param_cnt++, sizeof( int ), &number_of_threads ) );
     SUCCESS_OR_TERMINATE( zeKernelSetArgumentValue( _kernel, param_cnt++, sizeof( int ), &input_size ) );
-    SUCCESS_OR_TERMINATE(zeCommandListAppendLaunchKernel(command_list, _kernel, &group_count,
-        output_event, input_event_count, input_events.at(0)));
+
+    // the wait list has to be contiguous
+    std::vector<ze_event_handle_t> wait_events;
+    for (int wait : launch.waits)
+        wait_events.push_back(kernel_ts_event[wait]);
+    SUCCESS_OR_TERMINATE(zeCommandListAppendLaunchKernel(list, _kernel, &group_count,
+        kernel_ts_event[graph_event_count], (uint32_t)wait_events.size(), wait_events.empty() ? nullptr : wait_events.data()));
     graph_event_count++;
-    if (profiling)
-    {
-        size_t kernel_name_length = 0;
-        SUCCESS_OR_TERMINATE(zeKernelGetName(_kernel, &kernel_name_length, nullptr));
-        char* kernel_name = new char[kernel_name_length];
-        SUCCESS_OR_TERMINATE(zeKernelGetName(_kernel, &kernel_name_length, kernel_name));
-        kernel_names.push_back(kernel_name);
-    }
 }
 
-void createEventPoolAndEvents(ze_context_handle_t& context,
+// Events of a kernel timestamp pool; only the completion event is signaled with
+// host scope, it is the one the host waits for.
+static void createEventPoolAndEvents(ze_context_handle_t& context,
     ze_device_handle_t& device,
     ze_event_pool_handle_t& eventPool,
-    ze_event_pool_flag_t poolFlag,
     uint32_t poolSize,
+    uint32_t completionIndex,
     ze_event_handle_t* events)
 {
-    ze_event_pool_desc_t eventPoolDesc;
-    ze_event_desc_t eventDesc;
+    ze_event_pool_desc_t eventPoolDesc = { ZE_STRUCTURE_TYPE_EVENT_POOL_DESC };
+    ze_event_desc_t eventDesc = { ZE_STRUCTURE_TYPE_EVENT_DESC };
     eventPoolDesc.count = poolSize;
-    eventPoolDesc.flags = poolFlag;
+    eventPoolDesc.flags = ZE_EVENT_POOL_FLAG_KERNEL_TIMESTAMP | ZE_EVENT_POOL_FLAG_HOST_VISIBLE;
     SUCCESS_OR_TERMINATE(zeEventPoolCreate(context, &eventPoolDesc, 1, &device, &eventPool));
 
     for (uint32_t i = 0; i < poolSize; i++)
     {
         eventDesc.index = i;
-        eventDesc.signal = ZE_EVENT_SCOPE_FLAG_DEVICE;
+        eventDesc.signal = i == completionIndex ? ZE_EVENT_SCOPE_FLAG_HOST : ZE_EVENT_SCOPE_FLAG_DEVICE;
         eventDesc.wait = ZE_EVENT_SCOPE_FLAG_DEVICE;
         SUCCESS_OR_TERMINATE(zeEventCreate(eventPool, &eventDesc, events + i));
     }
 }
 
-void zenon::create_cmd_list()
+void zenon::append_input_copies(ze_command_list_handle_t list)
 {
     auto allocSize = sizeof(uint8_t) * input1->size();
+    // a caller's payload is already in USM host memory, the copy reads it in place
+    const void* src1 = payload ? payload->input1 : input1->data();
+    const void* src2 = payload ? payload->input2 : input2->data();
+    const void* mem_src1 = payload ? payload->mem_input1 : mem_input1->data();
+    const void* mem_src2 = payload ? payload->mem_input2 : mem_input2->data();
+    SUCCESS_OR_TERMINATE(zeCommandListAppendMemoryCopy(list, input1_buffer, src1, allocSize, nullptr, 0, nullptr));
+    SUCCESS_OR_TERMINATE(zeCommandListAppendBarrier(list, nullptr, 0, nullptr));
+    SUCCESS_OR_TERMINATE(zeCommandListAppendMemoryCopy(list, input2_buffer, src2, allocSize, nullptr, 0, nullptr));
+    SUCCESS_OR_TERMINATE(zeCommandListAppendBarrier(list, nullptr, 0, nullptr));
+    SUCCESS_OR_TERMINATE(zeCommandListAppendMemoryCopy(list, mem_input1_buffer, mem_src1, mem_input1->size(), nullptr, 0, nullptr));
+    SUCCESS_OR_TERMINATE(zeCommandListAppendBarrier(list, nullptr, 0, nullptr));
+    SUCCESS_OR_TERMINATE(zeCommandListAppendMemoryCopy(list, mem_input2_buffer, mem_src2, mem_input2->size(), nullptr, 0, nullptr));
+    SUCCESS_OR_TERMINATE(zeCommandListAppendBarrier(list, input_ready_event, 0, nullptr));
+}
+
+void zenon::append_output_copy(ze_command_list_handle_t list)
+{
+    int out = graph->find_tensor("out");
+    void* result_buffer = tensor_buffers[out >= 0 ? out : graph->get_nodes().back().output];
+    SUCCESS_OR_TERMINATE(zeCommandListAppendMemoryCopy(list, output->data(), result_buffer, sizeof(uint8_t) * input1->size(), output_ready_event, 1, &completion_event));
+}
+
+// Appends every node to the list of its lane and the sink barrier to lane 0.
+void zenon::append_graph(const std::vector<ze_command_list_handle_t>& lists)
+{
+    const graph_template& recorded = *recorded_graph;
+    const std::vector<launch_record>& launches = recorded.get_launches();
+    const std::vector<int>& sinks = recorded.get_sinks();
+
+    // The previous query's events are reset on the device, ahead of everything
+    // else in lane 0. The host only resets the completion event, which it polls
+    // and so cannot leave signaled until the next submit.
+    for (size_t e = 0; e < recorded.event_count(); e++)
+    {
+        if (kernel_ts_event[e] != completion_event)
+            SUCCESS_OR_TERMINATE(zeCommandListAppendEventReset(lists[0], kernel_ts_event[e]));
+    }
+    SUCCESS_OR_TERMINATE(zeCommandListAppendBarrier(lists[0], lists.size() > 1 ? lanes_reset_event : nullptr, 0, nullptr));
+    for (size_t l = 1; l < lists.size(); l++)
+        SUCCESS_OR_TERMINATE(zeCommandListAppendBarrier(lists[l], nullptr, 1, &lanes_reset_event));
+
+    graph_event_count = 0;
+    for (size_t n = 0; n < launches.size(); n++)
+        submit_kernel_to_cmd_list(lists[node_lane[n]], launches[n], recorded.get_threads(), recorded.get_input_size());
+
+    if (sinks.size() > 1)
+    {
+        std::vector<ze_event_handle_t> sink_events;
+        for (int sink : sinks)
+            sink_events.push_back(kernel_ts_event[sink]);
+        SUCCESS_OR_TERMINATE(zeCommandListAppendBarrier(lists[0], completion_event, (uint32_t)sink_events.size(), sink_events.data()));
+    }
+}
+
+ze_command_list_handle_t zenon::create_immediate_list(uint32_t ordinal, uint32_t index, ze_command_queue_mode_t mode)
+{
+    ze_command_queue_desc_t immediate_descriptor = { ZE_STRUCTURE_TYPE_COMMAND_QUEUE_DESC };
+    immediate_descriptor.ordinal = ordinal;
+    immediate_descriptor.index = index;
+    immediate_descriptor.mode = mode;
+    immediate_descriptor.priority = ZE_COMMAND_QUEUE_PRIORITY_NORMAL;
+    ze_command_list_handle_t list = nullptr;
+    SUCCESS_OR_TERMINATE(zeCommandListCreateImmediate(context, device, &immediate_descriptor, &list));
+    return list;
+}
+
+void zenon::create_cmd_list()
+{
+    const int batch_threads = number_of_threads * max_batch_size;
+
+    if (cpu_backend)
+    {
+        cpu.reset(new cpu_graph(*recorded_graph, tensor_buffers, tensor_bytes));
+        return;
+    }
+
+    if (overlap_copies && !disable_blitter)
+    {
+        // the download is chained behind the graph on the zenon's own copy queue,
+        // the upload is waited for on the host so no shared compute queue stalls on it
+        ze_event_handle_t copy_events[2];
+        createEventPoolAndEvents(context, device, copy_event_pool, 2, 1, copy_events);
+        input_ready_event = copy_events[0];
+        output_ready_event = copy_events[1];
+    }
 
     //input copy engine
     if (!disable_blitter) {
-        input_copy_command_list_descriptor.stype = ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC;
-        input_copy_command_list_descriptor.pNext = nullptr;
-        input_copy_command_list_descriptor.flags = 0;
-        input_copy_command_list_descriptor.commandQueueGroupOrdinal = copyOnlyQueueGroupOrdinal;
-        SUCCESS_OR_TERMINATE(zeCommandListCreate(context, device, &input_copy_command_list_descriptor, &input_copy_command_list));
-        SUCCESS_OR_TERMINATE(zeCommandListAppendMemoryCopy(input_copy_command_list, input1_buffer, input1->data(), allocSize, nullptr, 0, nullptr));
-        SUCCESS_OR_TERMINATE(zeCommandListAppendBarrier(input_copy_command_list, nullptr, 0, nullptr));
-        SUCCESS_OR_TERMINATE(zeCommandListAppendMemoryCopy(input_copy_command_list, input2_buffer, input2->data(), allocSize, nullptr, 0, nullptr));
-        SUCCESS_OR_TERMINATE(zeCommandListAppendBarrier(input_copy_command_list, nullptr, 0, nullptr));
-        SUCCESS_OR_TERMINATE(zeCommandListAppendMemoryCopy(input_copy_command_list, mem_input1_buffer, mem_input1->data(), input_size * memory_used_by_mem_bound_kernel, nullptr, 0, nullptr));
-        SUCCESS_OR_TERMINATE(zeCommandListAppendBarrier(input_copy_command_list, nullptr, 0, nullptr));
-        SUCCESS_OR_TERMINATE(zeCommandListAppendMemoryCopy(input_copy_command_list, mem_input2_buffer, mem_input2->data(), input_size * memory_used_by_mem_bound_kernel, nullptr, 0, nullptr));
-        SUCCESS_OR_TERMINATE(zeCommandListAppendBarrier(input_copy_command_list, nullptr, 0, nullptr));
-        SUCCESS_OR_TERMINATE(zeCommandListClose(input_copy_command_list));
+        // synchronous, an append returns once the copy is done, unless the copies
+        // are chained with events. Payload uploads change their source with every
+        // query, so they go through it as well.
+        if (immediate_cmd_lists || zero_copy)
+            immediate_copy_list = create_immediate_list(copyOnlyQueueGroupOrdinal, 0,
+                overlap_copies ? ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS : ZE_COMMAND_QUEUE_MODE_SYNCHRONOUS);
+        if (!immediate_cmd_lists)
+        {
+            input_copy_command_list_descriptor.stype = ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC;
+            input_copy_command_list_descriptor.pNext = nullptr;
+            input_copy_command_list_descriptor.flags = 0;
+            input_copy_command_list_descriptor.commandQueueGroupOrdinal = copyOnlyQueueGroupOrdinal;
+            SUCCESS_OR_TERMINATE(zeCommandListCreate(context, device, &input_copy_command_list_descriptor, &input_copy_command_list));
+            append_input_copies(input_copy_command_list);
+            SUCCESS_OR_TERMINATE(zeCommandListClose(input_copy_command_list));
+        }
     }
 
-    //compute engine
-    uint32_t group_size_x = 0;
-    uint32_t group_size_y = 0;
-    uint32_t group_size_z = 0;
-    SUCCESS_OR_TERMINATE(zeKernelSuggestGroupSize(kernel, number_of_threads, 1U, 1U, &group_size_x, &group_size_y, &group_size_z));
-    SUCCESS_OR_TERMINATE(zeKernelSetGroupSize(kernel, 32, 1, 1));
-    command_list_descriptor.stype = ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC;
-    command_list_descriptor.commandQueueGroupOrdinal = 0;
-    //printf( "\n threads: %d \n", number_of_threads,input_size);
-    SUCCESS_OR_TERMINATE(zeCommandListCreate(context, device, &command_list_descriptor, &command_list));
-
-    createEventPoolAndEvents(context, device, event_pool, ZE_EVENT_POOL_FLAG_KERNEL_TIMESTAMP, MAX_EVENTS_COUNT, &kernel_ts_event[0]);
-    group_count.groupCountX = number_of_threads/2;
+    //compute engine, the group size is set on the kernels by the registry
+    // lanes need engines of their own, with one CCS the serial list is all there is
+    lane_count = multi_ccs ? std::min<uint32_t>((uint32_t)std::max(1, branch_lanes), placed->compute_queue_count) : 1;
+    const graph_template& recorded = *recorded_graph;
+    node_lane = recorded.get_lanes(lane_count);
+
+    // one event per node, plus a barrier event when several nodes end the graph
+    const uint32_t event_count = recorded.event_count();
+    const uint32_t completion_index = recorded.completion_index();
+    // the extra last event tells the other lanes lane 0 has reset the graph's events
+    kernel_ts_event.assign(event_count + 1, nullptr);
+    kernel_ts_results.assign(event_count, {});
+    createEventPoolAndEvents(context, device, event_pool, event_count + 1, completion_index, kernel_ts_event.data());
+    completion_event = kernel_ts_event[completion_index];
+    lanes_reset_event = kernel_ts_event[event_count];
+    global_kernel_ts_event.push_back(completion_event);
+    group_count.groupCountX = batch_threads/2;
     group_count.groupCountY = 1;
     group_count.groupCountZ = 1;
 
-    kernel_names.clear();
-    if (!resnet)
+    if (immediate_cmd_lists)
     {
-        uint32_t number_of_kernels = 40;
-        if (disable_blitter) {
-            submit_kernel_to_cmd_list(set_n_to_output, { input1_buffer, input2_buffer }, im_buf1, kernel_ts_event[0], { nullptr }, 0, 1, input_size );
-            submit_kernel_to_cmd_list(set_n_to_output, { input1_buffer, input2_buffer }, im_buf2, kernel_ts_event[1], { nullptr }, 0, 2, input_size );
-            submit_kernel_to_cmd_list(set_n_to_output, { input1_buffer, input2_buffer }, im_buf3, kernel_ts_event[2], { nullptr }, 0, 3, input_size );
-        }
-        else {
-            submit_kernel_to_cmd_list(add_buffers_kernel, { input1_buffer, input2_buffer }, im_buf1, kernel_ts_event[0], { nullptr }, 0,number_of_threads,input_size);
-            submit_kernel_to_cmd_list(add_buffers_kernel, { input1_buffer, input2_buffer }, im_buf2, kernel_ts_event[1], { nullptr }, 0, number_of_threads,input_size);
-            submit_kernel_to_cmd_list(add_buffers_kernel, { input1_buffer, input2_buffer }, im_buf3, kernel_ts_event[2], { nullptr }, 0, number_of_threads,input_size);
-        }
-        for (int i = 1; i < number_of_kernels; i++)
-        {
-            if (i % 3 == 0)
-                submit_kernel_to_cmd_list(add_buffers_kernel, { im_buf1, im_buf2 }, im_buf3, kernel_ts_event[i + 2], { &kernel_ts_event[i] , &kernel_ts_event[i + 1] }, 2, number_of_threads,input_size);
-            if (i % 3 == 1)
-                submit_kernel_to_cmd_list(add_buffers_kernel, { im_buf3, im_buf2 }, im_buf1, kernel_ts_event[i + 2], { &kernel_ts_event[i] , &kernel_ts_event[i + 1] }, 2, number_of_threads,input_size);
-            if (i % 3 == 2)
-                submit_kernel_to_cmd_list(add_buffers_kernel, { im_buf1, im_buf3 }, im_buf2, kernel_ts_event[i + 2], { &kernel_ts_event[i] , &kernel_ts_event[i + 1] }, 2, number_of_threads,input_size);
-        }
-
-        submit_kernel_to_cmd_list(kernel, { im_buf3 }, output_buffer, kernel_ts_event[number_of_kernels + 2], { &kernel_ts_event[number_of_kernels], &kernel_ts_event[number_of_kernels + 1] }, 2, number_of_threads,input_size);
-        global_kernel_ts_event.push_back(kernel_ts_event[number_of_kernels + 2]);
-        SUCCESS_OR_TERMINATE(zeCommandListClose(command_list));
-        if (!disable_blitter) {
-            //Output copy engine
-            output_copy_command_list_descriptor.stype = ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC;
-            output_copy_command_list_descriptor.pNext = nullptr;
-            output_copy_command_list_descriptor.flags = 0;
-            output_copy_command_list_descriptor.commandQueueGroupOrdinal = copyOnlyQueueGroupOrdinal;
-
-            SUCCESS_OR_TERMINATE(zeCommandListCreate(context, device, &output_copy_command_list_descriptor, &output_copy_command_list));
-            SUCCESS_OR_TERMINATE(zeCommandListAppendMemoryCopy(output_copy_command_list, output->data(), im_buf2, allocSize, nullptr, 1, &kernel_ts_event[number_of_kernels + 2]));
-            SUCCESS_OR_TERMINATE(zeCommandListClose(output_copy_command_list));
-        }
+        // every engine can be picked per query, so every engine gets a list
+        for (uint32_t i = 0; i < placed->compute_queue_count; i++)
+            immediate_compute_lists.push_back(create_immediate_list(computeQueueGroupOrdinal, i, ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS));
     }
-    else {
-        if (disable_blitter) {
-            submit_kernel_to_cmd_list(set_n_to_output, { input1_buffer, input2_buffer }, im_buf1, kernel_ts_event[0], { nullptr }, 0, 1,number_of_threads,input_size);
-            submit_kernel_to_cmd_list(set_n_to_output, { input1_buffer, input2_buffer }, im_buf2, kernel_ts_event[1], { nullptr }, 0, 2,number_of_threads,input_size);
+    else
+    {
+        command_list_descriptor.stype = ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC;
+        command_list_descriptor.commandQueueGroupOrdinal = 0;
+        SUCCESS_OR_TERMINATE(zeCommandListCreate(context, device, &command_list_descriptor, &command_list));
+        lane_lists.assign(1, command_list);
+        for (size_t l = 1; l < lane_count; l++)
+        {
+            lane_lists.push_back(nullptr);
+            SUCCESS_OR_TERMINATE(zeCommandListCreate(context, device, &command_list_descriptor, &lane_lists.back()));
         }
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer, kernel_ts_event[0], { nullptr }, 0, 187717,number_of_threads,input_size);                                           //conv1
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer2, kernel_ts_event[1], { &kernel_ts_event[0] }, 1, 145798,number_of_threads,input_size);                               //pool1
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer, kernel_ts_event[2], { &kernel_ts_event[1] }, 1, 201456,number_of_threads,input_size);                               //<-res2a_branch1
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer2, kernel_ts_event[3], { &kernel_ts_event[1] }, 1, 67940,number_of_threads,input_size);                                //->res2a_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf5, kernel_ts_event[4], { &kernel_ts_event[3] }, 1, 56114,number_of_threads,input_size);                                //->res2a_branch2b
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer2, kernel_ts_event[5], { &kernel_ts_event[4] }, 1, 356590,number_of_threads,input_size);                               //->res2a_branch2c
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer2, kernel_ts_event[6], { &kernel_ts_event[2], &kernel_ts_event[5] }, 2, 200166,number_of_threads,input_size);          //->res2b_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf2, kernel_ts_event[7], { &kernel_ts_event[6] }, 1, 56114,number_of_threads,input_size);                                //->res2b_branch2b
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer, kernel_ts_event[8], { &kernel_ts_event[7] }, 1, 356590,number_of_threads,input_size);                               //->res2b_branch2c
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer2, kernel_ts_event[9], { &kernel_ts_event[8] }, 1, 200166,number_of_threads,input_size);                               //->res2c_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf5, kernel_ts_event[10], { &kernel_ts_event[9] }, 1, 56114,number_of_threads,input_size);                               //->res2c_branch2b
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer, kernel_ts_event[11], { &kernel_ts_event[10] }, 1, 356590,number_of_threads,input_size);                             //->res2c_branch2c
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer, kernel_ts_event[12], { &kernel_ts_event[11] }, 1, 183438,number_of_threads,input_size);                             //<-res3a_branch1
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer, kernel_ts_event[13], { &kernel_ts_event[11] }, 1, 56519,number_of_threads,input_size);                              //->res3a_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf3, kernel_ts_event[14], { &kernel_ts_event[13] }, 1, 55891,number_of_threads,input_size);                              //->res3a_branch2b
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer2, kernel_ts_event[15], { &kernel_ts_event[14] }, 1, 149931,number_of_threads,input_size);                             //->res3a_branch2c
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer, kernel_ts_event[16], { &kernel_ts_event[12], &kernel_ts_event[15] }, 2, 71228,number_of_threads,input_size);        //->res3b_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf6, kernel_ts_event[17], { &kernel_ts_event[16] }, 1, 55891,number_of_threads,input_size);                              //->res3b_branch2b
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer, kernel_ts_event[18], { &kernel_ts_event[17] }, 1, 138323,number_of_threads,input_size);                             //->res3b_branch2c
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer2, kernel_ts_event[19], { &kernel_ts_event[18] }, 1, 71228,number_of_threads,input_size);                              //->res3c_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf3, kernel_ts_event[20], { &kernel_ts_event[19] }, 1, 55891,number_of_threads,input_size);                              //->res3c_branch2b
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer, kernel_ts_event[21], { &kernel_ts_event[20] }, 1, 138323,number_of_threads,input_size);                             //->res3c_branch2c
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer2, kernel_ts_event[22], { &kernel_ts_event[21] }, 1, 71228,number_of_threads,input_size);                              //->res3c_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf6, kernel_ts_event[23], { &kernel_ts_event[22] }, 1, 55891,number_of_threads,input_size);                              //->res3c_branch2b
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer, kernel_ts_event[24], { &kernel_ts_event[23] }, 1, 138323,number_of_threads,input_size);                             //->res3c_branch2c
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer, kernel_ts_event[25], { &kernel_ts_event[24] }, 1, 84758,number_of_threads,input_size);                              //<-res4a_branch1
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer, kernel_ts_event[26], { &kernel_ts_event[24] }, 1, 27988,number_of_threads,input_size);                              //<-res4a_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf4, kernel_ts_event[27], { &kernel_ts_event[26] }, 1, 55420,number_of_threads,input_size);                              //<-res4a_branch2b
-        submit_kernel_to_cmd_list(mem_bound_kernel, { mem_input1_buffer, mem_input2_buffer }, mem_output_buffer2, kernel_ts_event[28], { &kernel_ts_event[27] }, 1, 60486,number_of_threads,input_size);                              //<-res4a_branch2c
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf6, kernel_ts_event[29], { &kernel_ts_event[25], &kernel_ts_event[28] }, 2, 26866,number_of_threads,input_size);        //->res4b_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf1, kernel_ts_event[30], { &kernel_ts_event[29] }, 1, 55420,number_of_threads,input_size);                              //<-res4b_branch2b
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf2, kernel_ts_event[31], { &kernel_ts_event[30] }, 1, 27559,number_of_threads,input_size);                              //<-res4b_branch2c
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf3, kernel_ts_event[32], { &kernel_ts_event[31] }, 1, 26866,number_of_threads,input_size);                              //<-res4c_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf4, kernel_ts_event[33], { &kernel_ts_event[32] }, 1, 55420,number_of_threads,input_size);                              //<-res4c_branch2b
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf4, kernel_ts_event[34], { &kernel_ts_event[33] }, 1, 27559,number_of_threads,input_size);                              //<-res4c_branch2c
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf6, kernel_ts_event[35], { &kernel_ts_event[34] }, 1, 26866,number_of_threads,input_size);                              //<-res4d_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf1, kernel_ts_event[36], { &kernel_ts_event[35] }, 1, 55420,number_of_threads,input_size);                              //<-res4d_branch2b
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf2, kernel_ts_event[37], { &kernel_ts_event[36] }, 1, 27559,number_of_threads,input_size);                              //<-res4d_branch2c
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf3, kernel_ts_event[38], { &kernel_ts_event[37] }, 1, 26866,number_of_threads,input_size);                              //<-res4e_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf4, kernel_ts_event[39], { &kernel_ts_event[38] }, 1, 55420,number_of_threads,input_size);                              //<-res4e_branch2b
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf4, kernel_ts_event[40], { &kernel_ts_event[39] }, 1, 27559,number_of_threads,input_size);                              //<-res4e_branch2c
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf6, kernel_ts_event[41], { &kernel_ts_event[40] }, 1, 26866,number_of_threads,input_size);                              //<-res4f_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf1, kernel_ts_event[42], { &kernel_ts_event[41] }, 1, 55420,number_of_threads,input_size);                              //<-res4f_branch2b
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf2, kernel_ts_event[43], { &kernel_ts_event[42] }, 1, 27559,number_of_threads,input_size);                              //<-res4f_branch2c
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf3, kernel_ts_event[44], { &kernel_ts_event[43] }, 1, 50121,number_of_threads,input_size);                              //<-res5a_branch1
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf4, kernel_ts_event[45], { &kernel_ts_event[43] }, 1, 16507,number_of_threads,input_size);                              //<-res5a_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf4, kernel_ts_event[46], { &kernel_ts_event[45] }, 1, 55398,number_of_threads,input_size);                              //<-res5a_branch2b
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf6, kernel_ts_event[47], { &kernel_ts_event[46] }, 1, 27278,number_of_threads,input_size);                              //<-res5a_branch2c
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf1, kernel_ts_event[48], { &kernel_ts_event[44], &kernel_ts_event[47] }, 2, 29580,number_of_threads,input_size);        //<-res5b_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf2, kernel_ts_event[49], { &kernel_ts_event[48] }, 1, 55398,number_of_threads,input_size);                              //<-res5b_branch2b
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf3, kernel_ts_event[50], { &kernel_ts_event[49] }, 1, 27278,number_of_threads,input_size);                              //<-res5b_branch2c
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf4, kernel_ts_event[51], { &kernel_ts_event[50] }, 1, 29580,number_of_threads,input_size);                               //<-res5c_branch2a
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, im_buf4, kernel_ts_event[52], { &kernel_ts_event[51] }, 1, 55398,number_of_threads,input_size);                              //<-res5c_branch2b
-        submit_kernel_to_cmd_list(cmp_bound_kernel, { input1_buffer, input2_buffer }, output_buffer, kernel_ts_event[53], { &kernel_ts_event[52] }, 1, 27278,number_of_threads,input_size);                         //<-res5c_branch2c
-        global_kernel_ts_event.push_back(kernel_ts_event[53]);
-
-        SUCCESS_OR_TERMINATE(zeCommandListClose(command_list));
-        if (!disable_blitter) {
-            //Output copy engine
-            output_copy_command_list_descriptor.stype = ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC;
-            output_copy_command_list_descriptor.pNext = nullptr;
-            output_copy_command_list_descriptor.flags = 0;
-            output_copy_command_list_descriptor.commandQueueGroupOrdinal = copyOnlyQueueGroupOrdinal;
-
-            SUCCESS_OR_TERMINATE(zeCommandListCreate(context, device, &output_copy_command_list_descriptor, &output_copy_command_list));
-            SUCCESS_OR_TERMINATE(zeCommandListAppendMemoryCopy(output_copy_command_list, output->data(), im_buf4, allocSize, nullptr, 1, &kernel_ts_event[53]));
-            SUCCESS_OR_TERMINATE(zeCommandListClose(output_copy_command_list));
+        {
+            // arguments are captured at append, the shared kernels are free again after it
+            std::lock_guard<std::mutex> lock(shared_kernels->mtx);
+            append_graph(lane_lists);
         }
+        for (auto list : lane_lists)
+            SUCCESS_OR_TERMINATE(zeCommandListClose(list));
     }
 
+    if (!disable_blitter && !immediate_cmd_lists) {
+        //Output copy engine
+        output_copy_command_list_descriptor.stype = ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC;
+        output_copy_command_list_descriptor.pNext = nullptr;
+        output_copy_command_list_descriptor.flags = 0;
+        output_copy_command_list_descriptor.commandQueueGroupOrdinal = copyOnlyQueueGroupOrdinal;
+
+        SUCCESS_OR_TERMINATE(zeCommandListCreate(context, device, &output_copy_command_list_descriptor, &output_copy_command_list));
+        append_output_copy(output_copy_command_list);
+        SUCCESS_OR_TERMINATE(zeCommandListClose(output_copy_command_list));
+    }
 }
 
-gpu_results zenon::run(uint32_t clinet_id)
+void zenon::copy_inputs()
 {
-    if (!disable_blitter) {
+    round_trip_timer timer(input_copy_stats);
+    if (immediate_cmd_lists || payload)
+        append_input_copies(immediate_copy_list);
+    else
         SUCCESS_OR_TERMINATE(zeCommandQueueExecuteCommandLists(input_copy_command_queue, 1, &input_copy_command_list, nullptr));
+    if (input_ready_event)
+    {
+        SUCCESS_OR_TERMINATE(zeEventHostSynchronize(input_ready_event, UINT64_MAX));
+        SUCCESS_OR_TERMINATE(zeEventHostReset(input_ready_event));
+    }
+    else if (!immediate_cmd_lists && !payload)
         SUCCESS_OR_TERMINATE(zeCommandQueueSynchronize(input_copy_command_queue, UINT64_MAX));
+}
+
+void zenon::copy_output()
+{
+    round_trip_timer timer(output_copy_stats);
+    if (immediate_cmd_lists)
+    {
+        append_output_copy(immediate_copy_list);
+        return;
     }
-    SUCCESS_OR_TERMINATE(zeCommandQueueExecuteCommandLists(command_queue, 1, &command_list, nullptr));
+    SUCCESS_OR_TERMINATE(zeCommandQueueExecuteCommandLists(output_copy_command_queue, 1, &output_copy_command_list, nullptr));
+    if (!output_ready_event)
+        SUCCESS_OR_TERMINATE(zeCommandQueueSynchronize(output_copy_command_queue, UINT64_MAX));
+}
+
+gpu_results zenon::run(uint32_t clinet_id)
+{
+    if (!disable_blitter)
+        copy_inputs();
+    wait_for_twin();
+    submit_compute();
+    // chained download, queued right behind the graph
+    if (output_ready_event)
+        copy_output();
 
     if( !single_thread )
-        SUCCESS_OR_TERMINATE(zeCommandQueueSynchronize(command_queue, UINT64_MAX));
+        finish_compute();
     //SUCCESS_OR_TERMINATE(zeEventHostSynchronize(global_kernel_ts_event.at(clinet_id), UINT32_MAX));
-    if (!disable_blitter && !single_thread) {
-        SUCCESS_OR_TERMINATE(zeCommandQueueExecuteCommandLists(output_copy_command_queue, 1, &output_copy_command_list, nullptr));
-        SUCCESS_OR_TERMINATE(zeCommandQueueSynchronize(output_copy_command_queue, UINT64_MAX));
-    }
+    if (!disable_blitter && !single_thread && !output_ready_event)
+        copy_output();
     if (profiling && !single_thread)
-    {
-        ze_device_properties_t devProperties = { ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES };
-        SUCCESS_OR_TERMINATE(zeDeviceGetProperties(device, &devProperties));
-
-        gpu_result.kernel_time.clear();
-        gpu_result.execuction_time = 0;
-        uint64_t timerResolution = devProperties.timerResolution;
-        uint64_t kernelDuration = 0;
-        for (int i = 0; i < graph_event_count - 2; i++)
-        {
-            SUCCESS_OR_TERMINATE(zeEventQueryKernelTimestamp(kernel_ts_event[i], &kernel_ts_results[i]));
-            kernelDuration = (kernel_ts_results[i].context.kernelEnd - kernel_ts_results[i].context.kernelStart) * timerResolution;
-            gpu_result.kernel_name.push_back(kernel_names.at(i));
-            gpu_result.kernel_time.push_back(kernelDuration);
-            gpu_result.execuction_time += kernelDuration;
-        }
-        gpu_result.kernels_start_time = kernel_ts_results[0].context.kernelStart * timerResolution;
-        gpu_result.kernels_end_time = kernel_ts_results[graph_event_count - 3].context.kernelStart * timerResolution;
-        gpu_result.gpu_time = (kernel_ts_results[graph_event_count - 3].context.kernelEnd - kernel_ts_results[0].context.kernelStart) * timerResolution;
-    }
+        set_timestamps();
     if( !single_thread )
     {
-        for( int i = 0; i < 54; i++ )
-        {
-            zeEventHostReset( kernel_ts_event[ i ] );
-        }
+        reset_events();
 
         if( log )
         {
@@ -630,20 +664,99 @@ gpu_results zenon::run(uint32_t clinet_id)
     return gpu_result;
 }
 
-bool zenon::is_finished( uint32_t clinet_id )
+// --overlap: the twin uploaded while this zenon's graph ran, its graph goes on
+// the same intermediates once the host has seen this one complete.
+void zenon::wait_for_twin()
 {
-    auto result = zeEventQueryStatus( global_kernel_ts_event.at( clinet_id ) );
+    if( !order )
+        return;
+    std::lock_guard<std::mutex> lock( order->mtx );
+    if( order->computing && order->computing != this )
+        SUCCESS_OR_TERMINATE( zeEventHostSynchronize( order->computing->completion_event, UINT64_MAX ) );
+    order->computing = this;
+}
+
+void zenon::submit_compute()
+{
+    round_trip_timer timer( submit_stats );
+    active_lanes = placed->acquire_ccs_group( lane_count, multi_ccs );
+    ccs_id = active_lanes[ 0 ]->index;
+    if( cpu )
+        cpu->start();
+    else if( immediate_cmd_lists )
+    {
+        // the lists are this zenon's own, no queue is shared with other zenons
+        std::vector<ze_command_list_handle_t> lists;
+        for( auto engine : active_lanes )
+            lists.push_back( immediate_compute_lists[ engine->index ] );
+        append_graph( lists );
+    }
+    else
+    {
+        std::unique_lock<std::mutex> group_lock( placed->submit_mtx, std::defer_lock );
+        if( lane_lists.size() > 1 )
+            group_lock.lock();
+        for( size_t l = 0; l < lane_lists.size(); l++ )
+        {
+            std::lock_guard<std::mutex> lock( active_lanes[ l ]->mtx );
+            SUCCESS_OR_TERMINATE( zeCommandQueueExecuteCommandLists( active_lanes[ l ]->queue, 1, &lane_lists[ l ], nullptr ) );
+        }
+    }
+}
+
+void zenon::print_submit_stats( std::ostream& out )
+{
+    // a synchronous immediate copy returns once the data has moved, a queued
+    // one once it is submitted, unless the host waits for it right after
+    out << "Host time per round trip (" << ( cpu_backend ? "cpu flow graph" : immediate_cmd_lists ? "immediate lists" : "command queue" ) << "):\n";
+    input_copy_stats.print( out, "input copy    " );
+    submit_stats.print( out, "compute submit" );
+    output_copy_stats.print( out, "output copy   " );
+}
+
+// The queue is shared with other zenons, so completion is the graph's terminal
+// event rather than a queue synchronize. Every lane ends before it, the barrier
+// in lane 0 waits for all sinks.
+void zenon::finish_compute()
+{
+    if( active_lanes.empty() )
+        return;
+    if( cpu )
+        cpu->finish();
+    else
+        SUCCESS_OR_TERMINATE( zeEventHostSynchronize( done_event(), UINT64_MAX ) );
+    if( order )
+    {
+        // before reset_events, the twin may be waiting for the completion event
+        std::lock_guard<std::mutex> lock( order->mtx );
+        if( order->computing == this )
+            order->computing = nullptr;
+    }
+    for( auto engine : active_lanes )
+        placed->release_ccs( *engine );
+    active_lanes.clear();
+}
+
+bool zenon::is_finished()
+{
+    if( cpu )
+        return cpu->is_finished();
+    auto result = zeEventQueryStatus( done_event() );
     return  result==ZE_RESULT_SUCCESS;
 }
 
+bool zenon::wait_finished( uint64_t timeout_ns )
+{
+    if( cpu )
+        return cpu->wait( timeout_ns );
+    return zeEventHostSynchronize( done_event(), timeout_ns ) == ZE_RESULT_SUCCESS;
+}
+
 gpu_results zenon::get_result( uint32_t clinet_id )
 {    
-    SUCCESS_OR_TERMINATE( zeCommandQueueSynchronize( command_queue, UINT64_MAX ) );
-    if( !disable_blitter )
-    {
-        SUCCESS_OR_TERMINATE( zeCommandQueueExecuteCommandLists( output_copy_command_queue, 1, &output_copy_command_list, nullptr ) );
-        SUCCESS_OR_TERMINATE( zeCommandQueueSynchronize( output_copy_command_queue, UINT64_MAX ) );
-    }
+    finish_compute();
+    if( !disable_blitter && !output_ready_event )
+        copy_output();
     if( log )
     {
         std::cout << "Output:\n";
@@ -665,43 +778,63 @@ gpu_results zenon::get_result( uint32_t clinet_id )
         }
         printf( "\n" );
     }
-    for( int i = 0; i < 54; i++ )
-    {
-        zeEventHostReset( kernel_ts_event[ i ] );
-    }
+    reset_events();
     return gpu_result;
 }
 
+void zenon::reset_events()
+{
+    if( cpu )
+        return;
+    zeEventHostReset( completion_event );
+    if( lane_count > 1 )
+        zeEventHostReset( lanes_reset_event );
+    if( output_ready_event )
+        zeEventHostReset( output_ready_event );
+}
+
 void zenon::set_timestamps() {
+    if (cpu)
+    {
+        const std::vector<uint64_t>& starts = cpu->get_start_ns();
+        const std::vector<uint64_t>& ends = cpu->get_end_ns();
+        gpu_result.kernel_time.clear();
+        gpu_result.kernel_name.clear();
+        gpu_result.execuction_time = 0;
+        uint64_t first_start = UINT64_MAX, last_end = 0;
+        for (size_t i = 0; i < starts.size(); i++)
+        {
+            gpu_result.kernel_name.push_back(recorded_graph->get_launches().at(i).name);
+            gpu_result.kernel_time.push_back(ends[i] - starts[i]);
+            gpu_result.execuction_time += ends[i] - starts[i];
+            first_start = std::min(first_start, starts[i]);
+            last_end = std::max(last_end, ends[i]);
+        }
+        gpu_result.kernels_start_time = first_start;
+        gpu_result.kernels_end_time = last_end;
+        gpu_result.gpu_time = last_end - first_start;
+        return;
+    }
     ze_device_properties_t devProperties = { ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES };
     SUCCESS_OR_TERMINATE(zeDeviceGetProperties(device, &devProperties));
 
     gpu_result.kernel_time.clear();
+    gpu_result.kernel_name.clear();
     gpu_result.execuction_time = 0;
     uint64_t timerResolution = devProperties.timerResolution;
     uint64_t kernelDuration = 0;
-    for (int i = 0; i < graph_event_count - 2; i++)
+    uint64_t first_start = UINT64_MAX, last_end = 0;
+    for (uint32_t i = 0; i < graph_event_count; i++)
     {
         SUCCESS_OR_TERMINATE(zeEventQueryKernelTimestamp(kernel_ts_event[i], &kernel_ts_results[i]));
         kernelDuration = (kernel_ts_results[i].context.kernelEnd - kernel_ts_results[i].context.kernelStart) * timerResolution;
-        gpu_result.kernel_name.push_back(kernel_names.at(i));
+        gpu_result.kernel_name.push_back(recorded_graph->get_launches().at(i).name);
         gpu_result.kernel_time.push_back(kernelDuration);
         gpu_result.execuction_time += kernelDuration;
+        first_start = std::min<uint64_t>(first_start, kernel_ts_results[i].context.kernelStart);
+        last_end = std::max<uint64_t>(last_end, kernel_ts_results[i].context.kernelEnd);
     }
-    gpu_result.kernels_start_time = kernel_ts_results[0].context.kernelStart * timerResolution;
-    gpu_result.kernels_end_time = kernel_ts_results[graph_event_count - 3].context.kernelStart * timerResolution;
-    gpu_result.gpu_time = (kernel_ts_results[graph_event_count - 3].context.kernelEnd - kernel_ts_results[0].context.kernelStart) * timerResolution;
+    gpu_result.kernels_start_time = first_start * timerResolution;
+    gpu_result.kernels_end_time = last_end * timerResolution;
+    gpu_result.gpu_time = (last_end - first_start) * timerResolution;
 }
-
-bool zenon::ze_initalized = false;
-std::vector<ze_driver_handle_t> zenon::drivers;
-ze_driver_handle_t zenon::driver;
-ze_context_desc_t zenon::context_descriptor = {};
-ze_context_handle_t zenon::context = nullptr;
-uint32_t zenon::number_of_devices = 0;
-std::vector<ze_device_handle_t> zenon::devices;
-ze_device_handle_t zenon::device;
-uint32_t zenon::command_queue_count = 1;
-uint32_t zenon::computeQueueGroupOrdinal = 0;
-uint32_t zenon::copyOnlyQueueGroupOrdinal = 0;
-uint32_t zenon::zenon_cntr = 0;
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+
+#include "ze_info/zenon_pool.hpp"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+static std::mutex park_mtx;
+static std::condition_variable park_cv;
+#endif
+
+bool parse_pool_wait_strategy( const std::string& name, pool_wait_strategy& strategy )
+{
+    if( name == "spin" )
+        strategy = pool_wait_strategy::spin;
+    else if( name == "yield" )
+        strategy = pool_wait_strategy::yield;
+    else if( name == "park" )
+        strategy = pool_wait_strategy::park;
+    else
+        return false;
+    return true;
+}
+
+const char* to_string( pool_wait_strategy strategy )
+{
+    switch( strategy )
+    {
+    case pool_wait_strategy::spin:
+        return "spin";
+    case pool_wait_strategy::yield:
+        return "yield";
+    case pool_wait_strategy::park:
+        return "park";
+    }
+    return "unknown";
+}
+
+zenon* zenon_pool::acquire()
+{
+    zenon* zenek = nullptr;
+    acquires++;
+    if( free_zenons.pop( zenek ) )
+        return zenek;
+
+    contended++;
+    uint32_t depth = ++waiting;
+    uint32_t max_depth = max_waiting.load();
+    while( depth > max_depth && !max_waiting.compare_exchange_weak( max_depth, depth ) );
+
+    auto start = std::chrono::high_resolution_clock::now();
+    switch( strategy )
+    {
+    case pool_wait_strategy::spin:
+        while( !free_zenons.pop( zenek ) );
+        break;
+    case pool_wait_strategy::yield:
+        while( !free_zenons.pop( zenek ) )
+            std::this_thread::yield();
+        break;
+    case pool_wait_strategy::park:
+        // short spin first, most waits on a busy pool are shorter than a futex round trip
+        for( int i = 0; i < 256; i++ )
+        {
+            if( free_zenons.pop( zenek ) )
+                break;
+        }
+        while( !zenek )
+        {
+            uint32_t seq = release_seq.load();
+            if( free_zenons.pop( zenek ) )
+                break;
+            park( seq );
+        }
+        break;
+    }
+    waiting--;
+
+    uint64_t wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::high_resolution_clock::now() - start ).count();
+    total_wait_ns += wait_ns;
+    uint64_t max_ns = max_wait_ns.load();
+    while( wait_ns > max_ns && !max_wait_ns.compare_exchange_weak( max_ns, wait_ns ) );
+    return zenek;
+}
+
+bool zenon_pool::try_acquire( zenon*& zenek )
+{
+    if( !free_zenons.pop( zenek ) )
+        return false;
+    acquires++;
+    return true;
+}
+
+void zenon_pool::release( zenon* zenek )
+{
+    free_zenons.push( zenek );
+    release_seq++;
+    if( parked.load() > 0 )
+        wake_one();
+}
+
+void zenon_pool::park( uint32_t seq )
+{
+    parks++;
+    parked++;
+#ifdef __linux__
+    // returns immediately if a release bumped release_seq after it was read
+    syscall( SYS_futex, reinterpret_cast<uint32_t*>( &release_seq ), FUTEX_WAIT_PRIVATE, seq, nullptr, nullptr, 0 );
+#else
+    std::unique_lock<std::mutex> lock( park_mtx );
+    park_cv.wait_for( lock, std::chrono::milliseconds( 1 ), [ & ] { return release_seq.load() != seq; } );
+#endif
+    parked--;
+}
+
+void zenon_pool::wake_one()
+{
+#ifdef __linux__
+    syscall( SYS_futex, reinterpret_cast<uint32_t*>( &release_seq ), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0 );
+#else
+    {
+        std::lock_guard<std::mutex> lock( park_mtx );
+    }
+    park_cv.notify_one();
+#endif
+}
+
+void zenon_pool::print_stats( std::ostream& out ) const
+{
+    uint64_t waits = contended.load();
+    out << "Zenon pool (" << to_string( strategy ) << "): acquires: " << acquires.load()
+        << " \t waited: " << waits
+        << " \t parks: " << parks.load()
+        << " \t avg wait: " << ( waits ? total_wait_ns.load() / waits / 1000.0 : 0.0 ) << " us"
+        << " \t max wait: " << max_wait_ns.load() / 1000.0 << " us"
+        << " \t max queue depth: " << max_waiting.load() << "\n";
+}